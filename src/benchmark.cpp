@@ -0,0 +1,554 @@
+
+/**
+ *
+ * @file benchmark.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @section History
+ * 17th October 2026: Created benchmark.cpp
+ *
+ * @section Licence
+ * Copyright (c) 2005-2013 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * @section Description
+ * Headless benchmark harness. Replays a demo macro or recorded input through a
+ * JJ1 level at a fixed frame rate and reports how long each frame spent in
+ * the level step, level drawing and video output.
+ *
+ */
+
+
+#include "benchmark.h"
+
+#include "game/game.h"
+#include "io/gfx/sprite.h"
+#include "io/gfx/video.h"
+#include "jj1bonuslevel/jj1bonuslevel.h"
+#include "jj1level/jj1level.h"
+#include "jj1level/jj1levelplayer/jj1bird.h"
+#include "mem.h"
+#include "surface.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+static const char* sectionNames[BSECTIONS] = {"step", "draw", "flip", "load"};
+
+
+/**
+ * Read the monotonic clock.
+ *
+ * @return Time in microseconds
+ */
+unsigned int benchTime () {
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+
+}
+
+
+static int compareTimes (const void* a, const void* b) {
+
+	unsigned int x = *((const unsigned int *)a);
+	unsigned int y = *((const unsigned int *)b);
+
+	return (x > y) - (x < y);
+
+}
+
+
+/**
+ * Create a timing collector.
+ *
+ * @param nFrames The maximum number of frames that will be recorded
+ * @param csvFile File to receive one line per frame, or NULL
+ */
+Benchmark::Benchmark (unsigned int nFrames, FILE* csvFile) {
+
+	int count;
+
+	csv = csvFile;
+	maxFrames = nFrames;
+	frames = 0;
+	steps = 0;
+
+	for (count = 0; count < BSECTIONS; count++)
+		times[count] = new unsigned int[nFrames];
+
+	if (csv) fprintf(csv, "frame,steps,step_us,draw_us,flip_us,load_us\n");
+
+	return;
+
+}
+
+
+/**
+ * Delete the timing collector.
+ */
+Benchmark::~Benchmark () {
+
+	int count;
+
+	for (count = 0; count < BSECTIONS; count++) delete[] times[count];
+
+	return;
+
+}
+
+
+/**
+ * Record the timings of a frame.
+ *
+ * @param nSteps Number of level steps taken during the frame
+ * @param stepTime Microseconds spent stepping the level
+ * @param drawTime Microseconds spent drawing the level
+ * @param flipTime Microseconds spent in Video::flip
+ * @param loadTime Microseconds spent loading a level
+ */
+void Benchmark::addFrame (unsigned int nSteps, unsigned int stepTime, unsigned int drawTime, unsigned int flipTime, unsigned int loadTime) {
+
+	if (frames >= maxFrames) return;
+
+	if (csv) fprintf(csv, "%u,%u,%u,%u,%u,%u\n", frames, nSteps, stepTime, drawTime, flipTime, loadTime);
+
+	times[BS_STEP][frames] = stepTime;
+	times[BS_DRAW][frames] = drawTime;
+	times[BS_FLIP][frames] = flipTime;
+	times[BS_LOAD][frames] = loadTime;
+
+	steps += nSteps;
+	frames++;
+
+	return;
+
+}
+
+
+/**
+ * Print a summary of the recorded timings.
+ *
+ * @param out File to print to
+ */
+void Benchmark::report (FILE* out) {
+
+	struct memstats mem;
+	unsigned long long total;
+	unsigned int count, section;
+
+	getMemStats(&mem);
+
+	fprintf(out, "heap: peak %u bytes in %u objects, %u free in %u blocks (largest %u), %u bytes moved\n",
+		mem.peak, mem.peakObjects, mem.freeBytes, mem.freeBlocks, mem.largestFree, mem.moved);
+
+	if (level) {
+
+		fprintf(out, "pools: events %d at most (%d in spare slots), bullets %d at most (%d in spare slots)\n",
+			level->eventPool.getPeak(), level->eventPool.getSparePeak(),
+			level->bulletPool.getPeak(), level->bulletPool.getSparePeak());
+
+	}
+
+	fprintf(out, "lists: birds %u (%u passes), %u bytes of stack per walk\n",
+		MovableList<JJ1Bird>::stats.maxLength, MovableList<JJ1Bird>::stats.maxPasses,
+		(unsigned int)sizeof(MovableList<JJ1Bird>));
+
+	fprintf(out, "scaled sprites: %u hits, %u misses, %u evictions, %u drawn directly\n",
+		spriteCache.stats.hits, spriteCache.stats.misses, spriteCache.stats.evictions, spriteCache.stats.bypasses);
+
+	fprintf(out, "frames: %u steps: %u\n", frames, steps);
+
+	if (!frames) return;
+
+	fprintf(out, "%-6s %10s %8s %8s %8s %8s %8s\n",
+		"", "total_us", "mean", "min", "median", "p95", "max");
+
+	for (section = 0; section < BSECTIONS; section++) {
+
+		total = 0;
+
+		for (count = 0; count < frames; count++) total += times[section][count];
+
+		// Leave out sections the mode does not time
+		if (!total) continue;
+
+		qsort(times[section], frames, sizeof(unsigned int), compareTimes);
+
+		fprintf(out, "%-6s %10llu %8llu %8u %8u %8u %8u\n",
+			sectionNames[section], total, total / frames,
+			times[section][0],
+			times[section][frames >> 1],
+			times[section][(frames * 95) / 100],
+			times[section][frames - 1]);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Time the conversion of the canvas to the output format on its own.
+ *
+ * @param frames Number of frames to convert
+ * @param changePalette Whether or not to change the palette every frame
+ * @param bench Timing collector
+ *
+ * @return Error code
+ */
+static int benchmarkFlip (int frames, bool changePalette, Benchmark* bench) {
+
+	unsigned int seed, start;
+	int count;
+
+	// Fill the canvas with repeatable noise
+	seed = 1;
+
+	for (count = 0; count < canvasW * canvasH; count++) {
+
+		seed = (seed * 1103515245) + 12345;
+		canvas.pix[count] = seed >> 24;
+
+	}
+
+	for (count = 0; count < frames; count++) {
+
+		if (changePalette) video.currentPalette[count & 255] ^= 0x0821;
+
+		start = benchTime();
+		video.flip(T_FRAME, NULL);
+		bench->addFrame(0, 0, 0, benchTime() - start);
+
+	}
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Time loading a level, from opening its files to the end of the constructor.
+ * Showing the loading screen is counted as the frame's flip, not its load.
+ *
+ * @param game The game the level belongs to
+ * @param fileName Name of the level file
+ * @param frames Number of times to load the level
+ * @param bench Timing collector
+ *
+ * @return Error code
+ */
+static int benchmarkLoad (Game* game, char* fileName, int frames, Benchmark* bench) {
+
+	JJ1Level* loaded;
+	unsigned int start, total;
+	int count;
+
+	for (count = 0; count < frames; count++) {
+
+		start = benchTime();
+
+		try {
+
+			loaded = new JJ1Level(game, fileName, false);
+
+		} catch (int e) {
+
+			logError("Could not load benchmark level", fileName);
+
+			return e;
+
+		}
+
+		total = benchTime() - start;
+
+		bench->addFrame(0, 0, 0, loaded->getLoadingTime(), total - loaded->getLoadingTime());
+
+		delete loaded;
+
+	}
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Time drawing a bonus level, turning a little every frame.
+ *
+ * @param game The game the level belongs to
+ * @param fileName Name of the bonus level file
+ * @param frames Number of frames to draw
+ * @param bench Timing collector
+ *
+ * @return Error code
+ */
+static int benchmarkBonus (Game* game, char* fileName, int frames, Benchmark* bench) {
+
+	JJ1BonusLevel* bonus;
+	int ret;
+
+	try {
+
+		bonus = new JJ1BonusLevel(game, fileName);
+
+	} catch (int e) {
+
+		logError("Could not load benchmark bonus level", fileName);
+
+		return e;
+
+	}
+
+	ret = bonus->benchmark(frames, bench);
+
+	delete bonus;
+
+	return ret;
+
+}
+
+
+/**
+ * Check a level's tile mask sweeps against stepping one point at a time.
+ *
+ * @param game The game the level belongs to
+ * @param fileName Name of the level file
+ * @param points Number of random points to sweep from
+ *
+ * @return Error code
+ */
+static int checkSweeps (Game* game, char* fileName, int points) {
+
+	JJ1Level* loaded;
+	int errors;
+
+	try {
+
+		loaded = new JJ1Level(game, fileName, false);
+
+	} catch (int e) {
+
+		logError("Could not load benchmark level", fileName);
+
+		return e;
+
+	}
+
+	errors = loaded->checkSweeps(points);
+
+	printf("sweeps: %d points, %d differed\n", points, errors);
+
+	delete loaded;
+
+	return errors? E_DATA: E_NONE;
+
+}
+
+
+/**
+ * Check the colour keyed row copies against testing each pixel.
+ *
+ * @param rows Number of random rows to copy
+ *
+ * @return Error code
+ */
+static int checkRows (int rows) {
+
+	int errors;
+
+	errors = checkRowBlits(rows);
+
+	printf("rows: %d copied, %d differed\n", rows, errors);
+
+	return errors? E_DATA: E_NONE;
+
+}
+
+
+/**
+ * Run the benchmark described by the command line.
+ *
+ * Usage: [-m demo|flip|load|bonus|rows|sweeps] [-f frames] [-d difficulty]
+ *        [-o csv file] [-r] [-p] [input file]
+ *
+ * The demo mode plays the input file, a MACRO.# demo macro, or with -r a
+ * recording holding the same header followed by one control code per level
+ * step.
+ * The flip mode times Video::flip alone on a noisy canvas, with -p changing
+ * the palette every frame.
+ * The load mode loads the input file, a JJ1 level, once per frame. Its
+ * loading screen is timed as the flip.
+ * The bonus mode draws the input file, a JJ1 bonus level, turning a little
+ * every frame.
+ * The rows mode checks that every way of copying a colour keyed row gives
+ * the same pixels, on 1000 random rows per frame, and fails if any differ.
+ * The sweeps mode loads the input file, a JJ1 level, and checks its tile mask
+ * sweeps against stepping one point at a time, from 1000 random points per
+ * frame, and fails if any differ.
+ *
+ * @param argc Number of arguments
+ * @param argv Array of arguments
+ *
+ * @return Error code
+ */
+int runBenchmark (int argc, char** argv) {
+
+	LocalGame* game;
+	JJ1DemoLevel* demo;
+	Benchmark* bench;
+	FILE* csv;
+	char* fileName;
+	const char* csvName;
+	const char* mode;
+	int frames, difficulty;
+	bool recorded, changePalette;
+	int count, ret;
+
+	fileName = NULL;
+	csvName = NULL;
+	mode = "demo";
+	frames = 1000;
+	difficulty = 0;
+	recorded = false;
+	changePalette = false;
+
+	for (count = 1; count < argc; count++) {
+
+		if (!strcmp(argv[count], "-m") && (count + 1 < argc)) mode = argv[++count];
+		else if (!strcmp(argv[count], "-f") && (count + 1 < argc)) frames = atoi(argv[++count]);
+		else if (!strcmp(argv[count], "-d") && (count + 1 < argc)) difficulty = atoi(argv[++count]) & 3;
+		else if (!strcmp(argv[count], "-o") && (count + 1 < argc)) csvName = argv[++count];
+		else if (!strcmp(argv[count], "-r")) recorded = true;
+		else if (!strcmp(argv[count], "-p")) changePalette = true;
+		else fileName = argv[count];
+
+	}
+
+	if (frames < 1) frames = 1;
+
+	if (strcmp(mode, "demo") && strcmp(mode, "flip") && strcmp(mode, "load") &&
+		strcmp(mode, "bonus") && strcmp(mode, "rows") && strcmp(mode, "sweeps")) {
+
+		logError("Unknown benchmark mode", mode);
+
+		return E_DEMOTYPE;
+
+	}
+
+	if (!strcmp(mode, "rows")) return checkRows(frames * 1000);
+
+	if (fileName) fileName = createString(fileName);
+	else if (!strcmp(mode, "load") || !strcmp(mode, "sweeps")) fileName = createString("LEVEL0.000");
+	else if (!strcmp(mode, "bonus")) fileName = createFileName(F_BONUSMAP, 0);
+	else fileName = createString(F_MACRO);
+
+	csv = NULL;
+
+	if (csvName) {
+
+		csv = fopen(csvName, "w");
+
+		if (!csv) logError("Could not open", csvName);
+
+	}
+
+	if (!strcmp(mode, "flip")) {
+
+		bench = new Benchmark(frames, csv);
+
+		ret = benchmarkFlip(frames, changePalette, bench);
+
+		bench->report(stdout);
+
+		delete bench;
+		delete[] fileName;
+
+		if (csv) fclose(csv);
+
+		return ret;
+
+	}
+
+	game = new LocalGame(fileName, difficulty);
+
+	if (!strcmp(mode, "sweeps")) {
+
+		ret = checkSweeps(game, fileName, frames * 1000);
+
+		delete game;
+		delete[] fileName;
+
+		if (csv) fclose(csv);
+
+		return ret;
+
+	}
+
+	if (!strcmp(mode, "load") || !strcmp(mode, "bonus")) {
+
+		bench = new Benchmark(frames, csv);
+
+		if (!strcmp(mode, "load")) ret = benchmarkLoad(game, fileName, frames, bench);
+		else ret = benchmarkBonus(game, fileName, frames, bench);
+
+		bench->report(stdout);
+
+		delete bench;
+		delete game;
+		delete[] fileName;
+
+		if (csv) fclose(csv);
+
+		return ret;
+
+	}
+
+	try {
+
+		level = demo = new JJ1DemoLevel(game, fileName, recorded);
+
+	} catch (int e) {
+
+		logError("Could not load benchmark input", fileName);
+
+		delete game;
+		delete[] fileName;
+		if (csv) fclose(csv);
+
+		return e;
+
+	}
+
+	bench = new Benchmark(frames, csv);
+
+	ret = demo->benchmark(frames, bench);
+
+	bench->report(stdout);
+
+	delete bench;
+	delete demo;
+	level = NULL;
+	delete game;
+	delete[] fileName;
+
+	if (csv) fclose(csv);
+
+	return ret;
+
+}
+
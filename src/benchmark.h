@@ -0,0 +1,70 @@
+
+/**
+ *
+ * @file benchmark.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @section History
+ * 17th October 2026: Created benchmark.h
+ *
+ * @section Licence
+ * Copyright (c) 2005-2013 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+
+#include <stdio.h>
+
+
+// Constants
+
+// Timed sections of a frame
+#define BS_STEP  0
+#define BS_DRAW  1
+#define BS_FLIP  2
+#define BS_LOAD  3
+
+#define BSECTIONS 4
+
+
+// Class
+
+/// Per-frame timing collector for the headless benchmark build
+class Benchmark {
+
+	private:
+		FILE*         csv; ///< Per-frame output, or NULL
+		unsigned int* times[BSECTIONS]; ///< Microseconds spent in each section, per frame
+		unsigned int  maxFrames; ///< Capacity of the timing arrays
+		unsigned int  frames; ///< Number of frames recorded
+		unsigned int  steps; ///< Number of level steps taken
+
+	public:
+		Benchmark  (unsigned int nFrames, FILE* csvFile);
+		~Benchmark ();
+
+		void addFrame (unsigned int nSteps, unsigned int stepTime, unsigned int drawTime, unsigned int flipTime, unsigned int loadTime = 0);
+		void report   (FILE* out);
+
+};
+
+
+// Functions
+
+unsigned int benchTime    ();
+int          runBenchmark (int argc, char** argv);
+
+#endif
+
@@ -77,6 +77,8 @@ Game::~Game () {
 
 	if (levelFile) delete[] levelFile;
 
+	clearPrefetch();
+
 	if (players) delete[] players;
 	localPlayer = NULL;
 
@@ -228,6 +230,7 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 			drawStrL(2,"Game::playLevel 3");
 		#endif
 		baseLevel = level = new(SaveVramAddr) JJ1Level(this, fileName, checkpoint);
+		clearPrefetch();
 		if (intro) {
 
 			JJ1Planet *planet;
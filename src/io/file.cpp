@@ -43,16 +43,52 @@
 	#include <fxcg/keyboard.h>
 	#include <fxcg/misc.h>
 #endif
+#ifdef FILE_MMAP
+	#include <sys/mman.h>
+#endif
+
+
+// Prefetch states
+#define PF_QUEUED  0
+#define PF_READING 1
+#define PF_READY   2
+#define PF_FAILED  3
+
+/// A file being read before it is opened
+struct Prefetch {
+
+	char*          name; ///< File name
+	File*          file; ///< The file while it is being read
+	unsigned char* data; ///< The contents of the file
+	int            size; ///< Size of the file
+	int            pos; ///< Number of bytes read so far
+	int            state; ///< Progress
+	void         (*opened)(File* file); ///< Called once the file has been read, or NULL
+
+};
+
+static Prefetch prefetches[PREFETCH_FILES];
+static int prefetchCount = 0;
+#ifdef PREFETCH_THREAD
+static SDL_Thread* prefetchThread = NULL; ///< Reads queued files
+static SDL_mutex*  prefetchLock = NULL; ///< Guards the prefetch table
+static SDL_cond*   prefetchCond = NULL; ///< Signalled when a file has been read
+static bool        prefetchRunning = false; ///< Whether or not the thread is still taking files
+#else
+static int         prefetchBytes = 0; ///< Memory held by prefetched files
+#endif
 /**
  * Try opening a file from the available paths
  *
  * @param name File name
  * @param write Whether or not the file can be written to
+ * @param count Whether or not to add the file to the open file count, which
+ * only the main thread may change
  */
 #ifndef CASIO
 static int fileCnt;
 #endif
-File::File (const char* name, bool write) {
+File::File (const char* name, bool write, bool count) {
 	#ifdef CASIO
 	file=-1;
 	#else
@@ -60,14 +96,29 @@ File::File (const char* name, bool write) {
 	#endif
 	Path* path;
 
+	buffer = NULL;
+	mapped = false;
+	borrowed = false;
+	counted = false;
+	bufferStart = 0;
+	bufferLength = 0;
+	bufferPos = 0;
+	size = 0;
+	filePath = NULL;
+
+	if (!write && usePrefetch(name)) return;
+
 	path = firstPath;
 
 	while (path) {
 
 		if (open(path->path, name, write)) {
 #ifndef CASIO
-			++fileCnt;
-			printf("*** fileCnt: %d\n", fileCnt);
+			if (count) {
+				counted = true;
+				++fileCnt;
+				printf("*** fileCnt: %d\n", fileCnt);
+			}
 #endif
 			return;
 		}
@@ -85,14 +136,26 @@ File::File (const char* name, bool write) {
  * Delete the file object.
  */
 File::~File () {
+	// A prefetched file's contents stay with the prefetcher
+	if(!borrowed){
+#ifdef FILE_MMAP
+		if(mapped)
+			munmap(buffer,size);
+		else
+#endif
+		if(buffer)
+			delete[] buffer;
+	}
 #ifdef CASIO
 	if(file>=0)
 		Bfile_CloseFile_OS(file);
 #else
-	if(file>0)
+	if(file)
 		fclose(file);
-	--fileCnt;
-	printf("*** fileCnt: %d\n", fileCnt);
+	if(counted){
+		--fileCnt;
+		printf("*** fileCnt: %d\n", fileCnt);
+	}
 #endif
 #ifdef VERBOSE
 	log("Closed file", filePath);
@@ -138,6 +201,25 @@ bool File::open (const char* path, const char* name, bool write) {
 #ifdef VERBOSE
 		log("Opened file", filePath);
 #endif
+		#ifdef CASIO
+			size = Bfile_GetFileSize_OS(file);
+		#else
+			fseek(file, 0, SEEK_END);
+			size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+		#endif
+		#ifdef FILE_MMAP
+			// Map the whole file, so reading never needs a system call
+			if (size > 0) {
+				void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+				if (map != MAP_FAILED) {
+					buffer = (unsigned char *)map;
+					bufferLength = size;
+					mapped = true;
+				}
+			}
+		#endif
+		if (!buffer) buffer = new unsigned char[FILE_BUFFER];
 		return true;
 	}
 	#ifdef CASIO
@@ -155,22 +237,81 @@ bool File::open (const char* path, const char* name, bool write) {
 }
 
 
+/**
+ * Use the contents of a file which has been read ahead, if there are any.
+ *
+ * @param name File name
+ *
+ * @return Whether or not the prefetched contents are being used
+ */
+bool File::usePrefetch (const char* name) {
+	Prefetch* prefetch;
+	int count;
+	prefetch = NULL;
+	#ifdef PREFETCH_THREAD
+	if(!prefetchLock) return false;
+	SDL_LockMutex(prefetchLock);
+	#endif
+	for (count = 0; count < prefetchCount; count++) {
+		if (!strcmp(prefetches[count].name, name)) prefetch = prefetches + count;
+	}
+	/* A file which has not been started is opened as usual. One which is being
+	read is finished first. */
+	#ifdef PREFETCH_THREAD
+	while (prefetch && (prefetch->state == PF_READING))
+		SDL_CondWait(prefetchCond, prefetchLock);
+	if (prefetch && (prefetch->state != PF_READY)) prefetch = NULL;
+	SDL_UnlockMutex(prefetchLock);
+	#else
+	while (prefetch && (prefetch->state == PF_READING)) prefetchStep();
+	if (prefetch && (prefetch->state != PF_READY)) prefetch = NULL;
+	#endif
+	if (!prefetch) return false;
+	buffer = prefetch->data;
+	bufferLength = size = prefetch->size;
+	mapped = true;
+	borrowed = true;
+	filePath = createString(name);
+#ifdef VERBOSE
+	log("Opened prefetched file", filePath);
+#endif
+	return true;
+}
+
+
+/**
+ * Read the next block of the file into the buffer.
+ *
+ * @return False if the end of the file has been reached
+ */
+bool File::fill () {
+	int length;
+	// A mapped file is already all in the buffer
+	if (mapped) return false;
+	bufferStart += bufferPos;
+	bufferPos = 0;
+	bufferLength = 0;
+	length = size - bufferStart;
+	if (length <= 0) return false;
+	if (length > FILE_BUFFER) length = FILE_BUFFER;
+	#ifdef CASIO
+		Bfile_ReadFile_OS(file, buffer, length, bufferStart);
+	#else
+		fseek(file, bufferStart, SEEK_SET);
+		length = fread(buffer, 1, length, file);
+	#endif
+	bufferLength = length;
+	return length > 0;
+}
+
+
 /**
  * Get the size of the file.
  *
  * @return The size of the file
  */
 int File::getSize () {
-#ifdef CASIO
-	return Bfile_GetFileSize_OS(file);
-#else
-	int pos, size;
-	pos = ftell(file);
-	fseek(file, 0, SEEK_END);
-	size = ftell(file);
-	fseek(file, pos, SEEK_SET);
 	return size;
-#endif
 }
 
 
@@ -180,11 +321,7 @@ int File::getSize () {
  * @return The current location
  */
 int File::tell () {
-	#ifdef CASIO
-		return Bfile_TellFile_OS(file);
-	#else
-		return ftell(file);
-	#endif
+	return bufferStart + bufferPos;
 }
 
 
@@ -195,30 +332,31 @@ int File::tell () {
  * @param reset Whether to offset from the current location or the start of the file
  */
 void File::seek (int offset, bool reset) {
-	#ifdef CASIO
-		if(reset)
-			Bfile_SeekFile_OS(file,offset);
-		else
-			Bfile_SeekFile_OS(file,Bfile_TellFile_OS(file)+offset);
-	#else
-		fseek(file, offset, reset ? SEEK_SET: SEEK_CUR);
-	#endif
+	int target;
+	target = reset ? offset: bufferStart + bufferPos + offset;
+	if (target < 0) return;
+	if (mapped) {
+		bufferPos = target;
+	} else if ((target >= bufferStart) && (target <= bufferStart + bufferLength)) {
+		// Still within the buffer
+		bufferPos = target - bufferStart;
+	} else {
+		// Read from the new location when next needed
+		bufferStart = target;
+		bufferPos = 0;
+		bufferLength = 0;
+	}
 }
 
 
 /**
  * Load an unsigned char from the file.
  *
- * @return The value read
+ * @return The value read, or 255 past the end of the file
  */
 unsigned char File::loadChar () {
-	#ifdef CASIO
-		unsigned char temp;
-		Bfile_ReadFile_OS(file,&temp,1,-1);
-		return temp;
-	#else
-		return fgetc(file);
-	#endif
+	if ((bufferPos >= bufferLength) && !fill()) return 255;
+	return buffer[bufferPos++];
 }
 
 
@@ -236,13 +374,8 @@ void File::storeChar (unsigned char val) {
 unsigned short int File::loadShort(){
 
 	unsigned short val;
-	#ifdef CASIO
-		Bfile_ReadFile_OS(file,&val,2,-1);
-		val=__builtin_bswap16(val);
-	#else
-		val = fgetc(file);
-		val |= fgetc(file) << 8;
-	#endif
+	val = loadChar();
+	val |= loadChar() << 8;
 	return val;
 }
 
@@ -288,28 +421,10 @@ void File::storeShort(unsigned short int val){
  */
 signed long int File::loadInt () {
 	unsigned long int val;
-	#ifdef CASIO
-		/*val = fgetc(file)<<24;
-		val |= fgetc(file)<<16;
-		val |= fgetc(file)<<8;
-		val |= fgetc(file);*/
-		/*unsigned char * v=(unsigned char *)&val;
-		Bfile_ReadFile_OS(file,v+3,1,-1);
-		Bfile_ReadFile_OS(file,v+2,1,-1);
-		Bfile_ReadFile_OS(file,v+1,1,-1);
-		Bfile_ReadFile_OS(file,v,1,-1);*/
-		Bfile_ReadFile_OS(file,&val,4,-1);
-		/*val = ((val>>24)&0xff) | // move byte 3 to byte 0
-                    ((val<<8)&0xff0000) | // move byte 1 to byte 2
-                    ((val>>8)&0xff00) | // move byte 2 to byte 1
-                    ((val<<24)&0xff000000); // byte 0 to byte 3*/
-		val=__builtin_bswap32(val);//Make sure you are using gcc 4.8 or later or other compiler which supports such features this should use the swap instruction
-	#else
-		val = fgetc(file);
-		val |= fgetc(file) << 8;
-		val |= fgetc(file) << 16;
-		val |= fgetc(file) << 24;
-	#endif
+	val = loadChar();
+	val |= loadChar() << 8;
+	val |= loadChar() << 16;
+	val |= loadChar() << 24;
 	return *((signed long int *)&val);
 }
 
@@ -341,11 +456,16 @@ unsigned char * File::loadBlock (int length) {
 	return buffer;
 }
 void File::loadBlock(int length,unsigned char * buf){
-	#ifdef CASIO
-		Bfile_ReadFile_OS(file,buf,length,-1);
-	#else
-		fread(buf, 1, length, file);
-	#endif
+	int count;
+	while (length > 0) {
+		if ((bufferPos >= bufferLength) && !fill()) break;
+		count = bufferLength - bufferPos;
+		if (count > length) count = length;
+		memcpy(buf, buffer + bufferPos, count);
+		bufferPos += count;
+		buf += count;
+		length -= count;
+	}
 }
 
 
@@ -354,120 +474,20 @@ void File::loadBlock(int length,unsigned char * buf){
  * Load a block of RLE compressed data from the file.
  *
  * @param length The length of the uncompressed block
- *
- * @return Buffer containing the uncompressed data
+ * @param buffer Buffer to receive the uncompressed data
  */
 void File::loadRLE (int length,unsigned char* buffer) {
 
-	int pos, count, next;
-	unsigned char byte,rle;
-	// Determine the offset that follows the block
-	#ifdef CASIO
-		{unsigned short tmp;
-		Bfile_ReadFile_OS(file,&tmp,2,-1);
-		next=__builtin_bswap16(tmp);}
-	#else
-		next = fgetc(file);
-		next |= fgetc(file) << 8;
-	#endif
-	#ifdef CASIO
-		next+=Bfile_TellFile_OS(file);
-	#else
-		next += ftell(file);
-	#endif
-	pos = 0;
-	/*#ifdef CASIO
-	itoa(next,(unsigned char *)bufP);
-	clearLine(5);
-	PrintXY(1,5,bufP-2,0x20,TEXT_COLOR_WHITE);
-	Bdisp_PutDisp_DD();
-	#else
-		printf("next: %d length: %d\n",next,length);
-	#endif*/
-	while (pos < length) {
-		#ifdef CASIO
-			Bfile_ReadFile_OS(file,&rle,1,-1);
-			//show percentage
-			/*itoa(pos,(unsigned char *)bufP);
-			clearLine(7);
-			PrintXY(1,7,bufP-2,0x20,TEXT_COLOR_WHITE);
-			Bdisp_PutDisp_DD();*/
-		#else
-			rle = fgetc(file);
-		#endif
-		if (rle & 128) {
-			#ifdef CASIO
-				Bfile_ReadFile_OS(file,&byte,1,-1);
-			#else
-				byte = fgetc(file);
-			#endif
-			for (count = 0; count < (rle & 127); count++) {
-				buffer[pos++] = byte;
-				if (pos >= length) break;
-			}
-			/*#ifdef CASIO
-				itoa(pos,(unsigned char *)bufP);
-				clearLine(4);
-				PrintXY(1,4,bufP-2,0x20,TEXT_COLOR_RED);
-				Bdisp_PutDisp_DD();
-			#endif*/
-		} else if (rle) {
-
-			/*for (count = 0; count < rle; count++) {
-				#ifdef CASIO
-					Bfile_ReadFile_OS(file,&buffer[pos++],1,-1);
-				#else
-					buffer[pos++] = fgetc(file);
-				#endif
-				if (pos >= length) break;
-
-			}*/
-
-			if((pos+rle)>=length){
-				//read for length then break
-				if((length-pos)>0){
-				#ifdef CASIO
-					Bfile_ReadFile_OS(file,&buffer[pos],(length-pos),-1);
-				#else
-					if(fread(&buffer[pos],1,(length-pos),file)!=(length-pos)){
-						puts("Errors byte");//punny yes?
-					}
-				#endif
-				pos+=(length-pos);
-				}
-			}else{
-				#ifdef CASIO
-					Bfile_ReadFile_OS(file,&buffer[pos],rle,-1);
-				#else
-					if(fread(&buffer[pos],1,rle,file)!=rle){
-						puts("Errors byte");
-					}
-				#endif
-				pos+=rle;
-				/*#ifdef CASIO
-					itoa(pos,(unsigned char *)bufP);
-					clearLine(4);
-					PrintXY(1,4,bufP-2,0x20,TEXT_COLOR_BLUE);
-					Bdisp_PutDisp_DD();
-				#endif*/
-			}
-		} else{
-			#ifdef CASIO
-				Bfile_ReadFile_OS(file,&buffer[pos++],1,-1);
-				/*itoa(pos,(unsigned char *)bufP);
-				clearLine(4);
-				PrintXY(1,4,bufP-2,0x20,TEXT_COLOR_GREEN);
-				Bdisp_PutDisp_DD();*/
-			#else
-				buffer[pos++] = fgetc(file);
-			#endif
-		}
-	}
-	#ifdef CASIO
-		Bfile_SeekFile_OS(file,next);
-	#else
-		fseek(file, next, SEEK_SET);
-	#endif
+	RLEDecoder decoder(this);
+	int pos;
+
+	pos = decoder.decode(buffer, length);
+
+	// The block ran out early
+	if (pos < length) memset(buffer + pos, 0, length - pos);
+
+	decoder.finish();
+
 }
 
 /**
@@ -475,16 +495,7 @@ void File::loadRLE (int length,unsigned char* buffer) {
  */
 void File::skipRLE(){
 	unsigned short next;
-	#ifdef CASIO
-		//unsigned char * n=(unsigned char *)&next;
-		//Bfile_ReadFile_OS(file,n+1,1,-1);
-		//Bfile_ReadFile_OS(file,n,1,-1);
-		Bfile_ReadFile_OS(file,&next,2,-1);
-		next=__builtin_bswap16(next);
-	#else
-		next = fgetc(file);
-		next |= fgetc(file) << 8;
-	#endif
+	next = loadShort();
 	seek(next,false);
 }
 
@@ -498,37 +509,18 @@ char * File::loadString () {
 	char *string;
 	unsigned char length;
 	int count;
-	#ifdef CASIO
-		Bfile_ReadFile_OS(file,&length,1,-1);
-	#else
-		length = fgetc(file);
-	#endif
+	length = loadChar();
 	if (length) {
 		string = new char[length + 1];
-		#ifdef CASIO
-			Bfile_ReadFile_OS(file,string,length,-1);
-		#else
-			fread(string, 1, length, file);
-		#endif
+		loadBlock(length, (unsigned char *)string);
 	}else {
 		// If the length is not given, assume it is an 8.3 file name
 		string = new char[13];
 		for (count = 0; count < 9; count++) {
-			#ifdef CASIO
-				Bfile_ReadFile_OS(file,&string[count],1,-1);
-			#else
-				string[count] = fgetc(file);
-			#endif
+			string[count] = loadChar();
 			if (string[count] == '.') {
-				#ifdef CASIO
-					Bfile_ReadFile_OS(file,&string[++count],3,-1);
-					count+=3;
-				#else
-					string[++count] = fgetc(file);
-					string[++count] = fgetc(file);
-					string[++count] = fgetc(file);
-					count++;
-				#endif
+				loadBlock(3, (unsigned char *)string + count + 1);
+				count += 4;
 				break;
 			}
 		}
@@ -542,38 +534,18 @@ char * File::loadString () {
 void File::skipString () {
 	unsigned char length;
 	int count;
-	#ifdef CASIO
-		Bfile_ReadFile_OS(file,&length,1,-1);
-	#else
-		length = fgetc(file);
-	#endif
+	length = loadChar();
 	if (length) {
 		//string = new char[length + 1];
 		seek(length,false);
 	}else {
 		// If the length is not given, assume it is an 8.3 file name
-		char string[14];
 		for (count = 0; count < 9; count++) {
-			#ifdef CASIO
-				Bfile_ReadFile_OS(file,&string[count],1,-1);
-			#else
-				string[count] = fgetc(file);
-			#endif
-			if (string[count] == '.') {
-				#ifdef CASIO
-					//Bfile_ReadFile_OS(file,&string[++count],3,-1);
-					//count+=3;
-					seek(3,false);
-				#else
-					string[++count] = fgetc(file);
-					string[++count] = fgetc(file);
-					string[++count] = fgetc(file);
-					count++;
-				#endif
+			if (loadChar() == '.') {
+				seek(3,false);
 				break;
 			}
 		}
-		length = count;
 	}
 }
 
@@ -627,15 +599,12 @@ void File::loadPixels(int length, int key,unsigned char * sorted) {
 	int count;
 	//sorted = new unsigned char[length];
 	pixels = (unsigned char*)alloca(length);//new unsigned char[length];
+	mask = 0;
 	// Read the mask
 	// Each mask pixel is either 0 or 1
 	// Four pixels are packed into the lower end of each byte
 	for (count = 0; count < length; count++) {
-		#ifdef CASIO
-			if (!(count & 3)) Bfile_ReadFile_OS(file,&mask,1,-1);
-		#else
-			if (!(count & 3)) mask = fgetc(file);
-		#endif
+		if (!(count & 3)) mask = loadChar();
 		pixels[count] = (mask >> (count & 3)) & 1;
 	}
 	// Pixels are loaded if the corresponding mask pixel is 1, otherwise
@@ -651,12 +620,7 @@ void File::loadPixels(int length, int key,unsigned char * sorted) {
 		if (sorted[count] == 1) {
 			// The unmasked portions are transparent, so no masked
 			// portion should be transparent.
-			#ifdef CASIO
-				while (pixels[count] == key)
-					Bfile_ReadFile_OS(file,&pixels[count],1,-1);
-			#else
-				while (pixels[count] == key) pixels[count] = fgetc(file);
-			#endif
+			while (pixels[count] == key) pixels[count] = loadChar();
 		}
 	}
 	// Rearrange pixels in correct order
@@ -696,6 +660,568 @@ void File::loadPalette6(unsigned char* palette, bool rle) {
 }
 
 
+#ifndef CASIO
+/**
+ * Write a block of data to a new file in the first directory path.
+ *
+ * @param name File name
+ * @param data The data
+ * @param length Number of bytes
+ *
+ * @return Whether or not the whole block was written
+ */
+bool saveFile (const char* name, const void* data, int length) {
+
+	FILE* out;
+	char* filePath;
+	int written;
+
+	filePath = createString(firstPath->path, name);
+	out = fopen(filePath, "wb");
+
+	if (!out) {
+
+		log("Could not write file", filePath);
+		delete[] filePath;
+
+		return false;
+
+	}
+
+	written = fwrite(data, 1, length, out);
+	fclose(out);
+
+#ifdef VERBOSE
+	log("Wrote file", filePath);
+#endif
+	delete[] filePath;
+
+	return written == length;
+
+}
+#endif
+
+
+/**
+ * Open a queued file and make room for its contents.
+ *
+ * @param prefetch The queued file
+ *
+ * @return The file's new state
+ */
+static int startPrefetch (Prefetch* prefetch) {
+
+	File* file;
+
+	try {
+
+		file = new File(prefetch->name, false, false);
+
+	} catch (int e) {
+
+		return PF_FAILED;
+
+	}
+
+	prefetch->size = file->getSize();
+	prefetch->data = NULL;
+
+#ifndef PREFETCH_THREAD
+	if (prefetchBytes + prefetch->size <= PREFETCH_LIMIT)
+#endif
+		prefetch->data = (unsigned char *)malloc(prefetch->size ? prefetch->size: 1);
+
+	if (!prefetch->data) {
+
+		// Leave it to be read when it is opened
+		delete file;
+
+		return PF_FAILED;
+
+	}
+
+#ifndef PREFETCH_THREAD
+	prefetchBytes += prefetch->size;
+#endif
+
+	prefetch->file = file;
+	prefetch->pos = 0;
+
+	return PF_READING;
+
+}
+
+
+/**
+ * Read some more of a file being prefetched.
+ *
+ * @param prefetch The file
+ * @param length Maximum number of bytes to read
+ *
+ * @return Whether or not the file has been read completely
+ */
+static bool readPrefetch (Prefetch* prefetch, int length) {
+
+	if (length > prefetch->size - prefetch->pos) length = prefetch->size - prefetch->pos;
+
+	prefetch->file->loadBlock(length, prefetch->data + prefetch->pos);
+	prefetch->pos += length;
+
+	if (prefetch->pos < prefetch->size) return false;
+
+	delete prefetch->file;
+	prefetch->file = NULL;
+
+	return true;
+
+}
+
+
+/**
+ * Let the file which has just been read queue the files it refers to.
+ *
+ * @param prefetch The file
+ */
+static void openedPrefetch (Prefetch* prefetch) {
+
+	File* file;
+
+	if (!prefetch->opened) return;
+
+	try {
+
+		file = new File(prefetch->name, false, false);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	prefetch->opened(file);
+
+	delete file;
+
+	return;
+
+}
+
+
+#ifdef PREFETCH_THREAD
+/**
+ * Read queued files until there are none left.
+ *
+ * @param data Unused
+ *
+ * @return Thread exit code
+ */
+static int prefetchFiles (void* data) {
+
+	(void)data;
+
+	Prefetch* prefetch;
+	int count, state;
+
+	SDL_LockMutex(prefetchLock);
+
+	while (true) {
+
+		prefetch = NULL;
+
+		for (count = 0; count < prefetchCount; count++) {
+
+			if (prefetches[count].state == PF_QUEUED) {
+
+				prefetch = prefetches + count;
+
+				break;
+
+			}
+
+		}
+
+		if (!prefetch) break;
+
+		// Files are opened unlocked, and a queued file is opened as usual
+		SDL_UnlockMutex(prefetchLock);
+		state = startPrefetch(prefetch);
+		SDL_LockMutex(prefetchLock);
+
+		prefetch->state = state;
+
+		if (prefetch->state == PF_READING) {
+
+			SDL_UnlockMutex(prefetchLock);
+			readPrefetch(prefetch, prefetch->size);
+			SDL_LockMutex(prefetchLock);
+
+			prefetch->state = PF_READY;
+			SDL_CondBroadcast(prefetchCond);
+
+			SDL_UnlockMutex(prefetchLock);
+			openedPrefetch(prefetch);
+			SDL_LockMutex(prefetchLock);
+
+		}
+
+	}
+
+	prefetchRunning = false;
+
+	SDL_UnlockMutex(prefetchLock);
+
+	return 0;
+
+}
+#endif
+
+
+/**
+ * Queue a file to be read into memory before it is opened.
+ *
+ * @param name File name
+ * @param opened Called with the file once it has been read, or NULL
+ */
+void prefetchFile (const char* name, void (*opened)(File* file)) {
+
+	Prefetch* prefetch;
+	int count;
+
+#ifdef PREFETCH_THREAD
+	if (!prefetchLock) {
+
+		prefetchLock = SDL_CreateMutex();
+		prefetchCond = SDL_CreateCond();
+
+	}
+
+	if (!prefetchLock || !prefetchCond) return;
+
+	SDL_LockMutex(prefetchLock);
+#endif
+
+	prefetch = NULL;
+
+	for (count = 0; count < prefetchCount; count++) {
+
+		if (!strcmp(prefetches[count].name, name)) prefetch = prefetches + count;
+
+	}
+
+	if (!prefetch && (prefetchCount < PREFETCH_FILES)) {
+
+		prefetch = prefetches + prefetchCount;
+		prefetch->name = createString(name);
+		prefetch->file = NULL;
+		prefetch->data = NULL;
+		prefetch->size = 0;
+		prefetch->pos = 0;
+		prefetch->state = PF_QUEUED;
+		prefetch->opened = opened;
+		prefetchCount++;
+
+	}
+
+#ifdef PREFETCH_THREAD
+	if (!prefetchRunning) {
+
+		// A thread which has run out of files has finished, or is about to
+		if (prefetchThread) SDL_WaitThread(prefetchThread, NULL);
+
+		prefetchThread = SDL_CreateThread(prefetchFiles, NULL);
+		prefetchRunning = (prefetchThread != NULL);
+
+	}
+
+	SDL_UnlockMutex(prefetchLock);
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Read a little more of the queued files. Called once per frame.
+ */
+void prefetchStep () {
+
+#ifndef PREFETCH_THREAD
+	Prefetch* prefetch;
+	int count;
+
+	for (count = 0; count < prefetchCount; count++) {
+
+		prefetch = prefetches + count;
+
+		if (prefetch->state == PF_QUEUED) {
+
+			prefetch->state = startPrefetch(prefetch);
+
+			return;
+
+		}
+
+		if (prefetch->state == PF_READING) {
+
+			if (readPrefetch(prefetch, PREFETCH_CHUNK)) {
+
+				prefetch->state = PF_READY;
+				openedPrefetch(prefetch);
+
+			}
+
+			return;
+
+		}
+
+	}
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Forget all prefetched files, finishing any which are being read.
+ */
+void clearPrefetch () {
+
+	int count;
+
+#ifdef PREFETCH_THREAD
+	if (prefetchThread) {
+
+		SDL_WaitThread(prefetchThread, NULL);
+		prefetchThread = NULL;
+
+	}
+#endif
+
+	for (count = 0; count < prefetchCount; count++) {
+
+		if (prefetches[count].file) delete prefetches[count].file;
+		if (prefetches[count].data) free(prefetches[count].data);
+		delete[] prefetches[count].name;
+
+	}
+
+	prefetchCount = 0;
+
+#ifndef PREFETCH_THREAD
+	prefetchBytes = 0;
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Start decoding the RLE block at the current position in a file.
+ *
+ * @param source File containing the block
+ */
+RLEDecoder::RLEDecoder (File* source) {
+
+	file = source;
+	data = NULL;
+	dataLength = 0;
+	dataPos = 0;
+	run = 0;
+	literal = 0;
+	fillByte = 0;
+
+	// Determine the offset that follows the block
+	next = file->loadShort();
+	next += file->tell();
+
+	return;
+
+}
+
+
+/**
+ * Start decoding RLE data held in memory.
+ *
+ * @param source The RLE data, without the block length
+ * @param length Number of bytes of RLE data
+ */
+RLEDecoder::RLEDecoder (const unsigned char* source, int length) {
+
+	file = NULL;
+	data = source;
+	dataLength = length;
+	dataPos = 0;
+	next = 0;
+	run = 0;
+	literal = 0;
+	fillByte = 0;
+
+	return;
+
+}
+
+
+/**
+ * Read the next byte of RLE data.
+ *
+ * @return The byte, or -1 if the data has run out
+ */
+int RLEDecoder::nextByte () {
+
+	if (file) {
+
+		if ((file->bufferPos >= file->bufferLength) && !file->fill()) return -1;
+
+		return file->buffer[file->bufferPos++];
+
+	}
+
+	if (dataPos >= dataLength) return -1;
+
+	return data[dataPos++];
+
+}
+
+
+/**
+ * Copy literal bytes from the RLE data.
+ *
+ * @param window Buffer to receive the bytes, or NULL to skip them
+ * @param length Number of bytes
+ *
+ * @return Number of bytes copied
+ */
+int RLEDecoder::copy (unsigned char* window, int length) {
+
+	int count, chunk;
+
+	if (!file) {
+
+		if (length > dataLength - dataPos) length = dataLength - dataPos;
+		if (window) memcpy(window, data + dataPos, length);
+		dataPos += length;
+
+		return length;
+
+	}
+
+	if (!window) {
+
+		if (length > file->size - file->tell()) length = file->size - file->tell();
+		file->seek(length, false);
+
+		return length;
+
+	}
+
+	count = 0;
+
+	while (count < length) {
+
+		if ((file->bufferPos >= file->bufferLength) && !file->fill()) break;
+
+		chunk = file->bufferLength - file->bufferPos;
+		if (chunk > length - count) chunk = length - count;
+
+		memcpy(window + count, file->buffer + file->bufferPos, chunk);
+		file->bufferPos += chunk;
+		count += chunk;
+
+	}
+
+	return count;
+
+}
+
+
+/**
+ * Decode the next part of the block. A fill or copy which does not fit in
+ * the window carries on into the next call.
+ *
+ * @param window Buffer to receive the uncompressed data, or NULL to discard it
+ * @param length Number of uncompressed bytes to produce
+ *
+ * @return Number of bytes produced, less than length if the data ran out
+ */
+int RLEDecoder::decode (unsigned char* window, int length) {
+
+	int pos, count, code, fill;
+
+	pos = 0;
+
+	while (pos < length) {
+
+		if (run) {
+
+			count = (run < length - pos) ? run: length - pos;
+			if (window) memset(window + pos, fillByte, count);
+			run -= count;
+			pos += count;
+
+		} else if (literal) {
+
+			count = (literal < length - pos) ? literal: length - pos;
+			count = copy(window ? window + pos: NULL, count);
+			if (!count) break;
+			literal -= count;
+			pos += count;
+
+		} else {
+
+			code = nextByte();
+
+			if (code < 0) break;
+
+			if (code & 128) {
+
+				fill = nextByte();
+
+				if (fill < 0) break;
+
+				fillByte = fill;
+				run = code & 127;
+
+			} else if (code) literal = code;
+			else literal = 1; // 0 bytes means 1 byte
+
+		}
+
+	}
+
+	return pos;
+
+}
+
+
+/**
+ * Pass over the next part of the block.
+ *
+ * @param length Number of uncompressed bytes to pass over
+ *
+ * @return Number of bytes passed over
+ */
+int RLEDecoder::skip (int length) {
+
+	return decode(NULL, length);
+
+}
+
+
+/**
+ * Move the file to the end of the block, however much has been decoded.
+ */
+void RLEDecoder::finish () {
+
+	if (file) file->seek(next, true);
+
+	return;
+
+}
+
+
 /**
  * Create a new directory path object.
  *
@@ -33,6 +33,30 @@
 #include <stdio.h>
 #include "surface.h"
 
+// Constants
+
+/* Files are read through a buffer, so that loading a byte does not take a
+system call. Where mmap is available the buffer is the whole file. */
+#ifdef CASIO
+	#define FILE_BUFFER 8192
+#else
+	#define FILE_BUFFER 65536
+	#ifndef _WIN32
+		#define FILE_MMAP
+	#endif
+#endif
+
+/* Files can be read into memory before they are opened, so that the next
+level loads while something else is on screen. On the desktop a thread reads
+them. On the Prizm a little is read each frame, within a memory budget. */
+#define PREFETCH_FILES 8
+#ifdef CASIO
+	#define PREFETCH_CHUNK 4096 /* Bytes read per frame */
+	#define PREFETCH_LIMIT 65536 /* Bytes which can be held at once */
+#else
+	#define PREFETCH_THREAD
+#endif
+
 // Classes
 
 /// File i/o
@@ -40,14 +64,27 @@ class File {
 
 	private:
 		char* filePath;
-		bool open (const char* path, const char* name, bool write);
+		unsigned char* buffer; ///< Read-ahead buffer, or the mapped file
+		int   bufferStart; ///< Offset in the file of the start of the buffer
+		int   bufferLength; ///< Number of bytes in the buffer
+		int   bufferPos; ///< Read position within the buffer
+		int   size; ///< Size of the file
+		bool  mapped; ///< Whether or not the buffer is a mapping of the whole file
+		bool  borrowed; ///< Whether or not the buffer belongs to the prefetcher
+		bool  counted; ///< Whether or not the file is in the open file count
+
+		bool open        (const char* path, const char* name, bool write);
+		bool usePrefetch (const char* name);
+		bool fill ();
+
+		friend class RLEDecoder;
 	public:
 		#ifdef CASIO
 		int file=-1;
 		#else
 		FILE* file;
 		#endif
-		File                           (const char* name, bool write);
+		File                           (const char* name, bool write, bool count = true);
 		~File                          ();
 
 		int                getSize     ();
@@ -78,6 +115,32 @@ class File {
 
 };
 
+/// Decoder for RLE blocks, read from a file or from memory
+class RLEDecoder {
+
+	private:
+		File*                file; ///< Source file, or NULL
+		const unsigned char* data; ///< Source data, if there is no file
+		int                  dataLength; ///< Number of bytes of source data
+		int                  dataPos; ///< Read position within the source data
+		int                  next; ///< Offset in the file of the end of the block
+		int                  run; ///< Bytes of the current fill still to be produced
+		int                  literal; ///< Bytes of the current copy still to be produced
+		unsigned char        fillByte; ///< Value of the current fill
+
+		int  nextByte ();
+		int  copy     (unsigned char* window, int length);
+
+	public:
+		RLEDecoder (File* source);
+		RLEDecoder (const unsigned char* source, int length);
+
+		int  decode (unsigned char* window, int length);
+		int  skip   (int length);
+		void finish ();
+
+};
+
 /// Directory path
 class Path {
 
@@ -96,5 +159,15 @@ class Path {
 // Paths to files
 EXTERN Path* firstPath;
 
+
+// Functions
+
+void prefetchFile  (const char* name, void (*opened)(File* file) = NULL);
+void prefetchStep  ();
+void clearPrefetch ();
+#ifndef CASIO
+bool saveFile      (const char* name, const void* data, int length);
+#endif
+
 #endif
 
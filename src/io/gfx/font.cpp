@@ -96,8 +96,8 @@ Font::Font (const char* fileName){
 			height |= pixels[3] << 8;
 			if ((size - 4) >= (width * height)){
 				//characters[count] = createSurface(pixels + 4, width, height);
-				characters[count].pix=(unsigned char *)objs[ramid].ptr+objs[ramid].size;
 				resizeobj(ramid,objs[ramid].size+(width*height));
+				characters[count].pix=(unsigned char *)objs[ramid].ptr+objs[ramid].size-(width*height);
 				memcpy(characters[count].pix,pixels+4,width*height);
 				characters[count].w=width;
 				characters[count].h=height;
@@ -121,6 +121,7 @@ Font::Font (const char* fileName){
 	}
 	//delete[] blank;
 	delete file;
+	linkCharacters();
 	// Create ASCII->font map
 	for (count = 0; count < 33; count++) map[count] = 0;
 	map[33] = 107; // !
@@ -304,8 +305,8 @@ Font::Font (bool bonus) {
 		else width <<= 2;
 
 		file->seek(4, false);
-		unsigned char * pixels=(unsigned char *)objs[ramid].ptr+objs[ramid].size;
 		resizeobj(ramid,objs[ramid].size+(width*height));
+		unsigned char * pixels=(unsigned char *)objs[ramid].ptr+objs[ramid].size-(width*height);
 		file->loadPixels(width * height,pixels);
 
 		//characters[count] = createSurface(pixels, width, height);
@@ -319,6 +320,7 @@ Font::Font (bool bonus) {
 		//delete[] pixels;
 	}
 	delete file;
+	linkCharacters();
 	lineHeight = characters[0].h;
 	// Create blank character data
 	//pixels = new unsigned char[3];
@@ -370,6 +372,30 @@ Font::Font (bool bonus) {
 }
 
 
+/**
+ * Point the characters at the font's pixel data. Growing the data while
+ * loading may have moved it.
+ */
+void Font::linkCharacters () {
+
+	int count, offset;
+
+	offset = 0;
+
+	for (count = 0; count < nCharacters; count++) {
+
+		if (characters[count].pix == blankFont) continue;
+
+		characters[count].pix = (unsigned char *)objs[ramid].ptr + offset;
+		offset += characters[count].w * characters[count].h;
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Delete the font.
  */
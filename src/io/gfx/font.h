@@ -46,6 +46,7 @@ class Font {
 		unsigned 			lineHeight; ///< Vertical spacing of displayed characters
 		char				map[128]; ///< Maps ASCII values to symbol indices
 		void blitFont(miniSurface*surface, int xo, int yo);
+		void linkCharacters ();
 	public:
 		bool remaped;
 		unsigned char		paletteF[256];
@@ -44,6 +44,7 @@
 PaletteEffect::PaletteEffect (PaletteEffect* nextPE) {
 
 	next = nextPE;
+	lastState = PE_NOSTATE;
 
 	return;
 
@@ -79,6 +80,56 @@ void PaletteEffect::apply (unsigned short* shownPalette, bool direct, int mspf)
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int PaletteEffect::getState () {
+
+	return 0;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void PaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	return;
+
+}
+
+
+/**
+ * Check whether or not any effect in the chain would change its output since
+ * the last check.
+ *
+ * @return True if the whole chain would give the same palette as before
+ */
+bool PaletteEffect::unchanged () {
+
+	int state;
+	bool same;
+
+	state = getState();
+	same = (state == lastState);
+	lastState = state;
+
+	// Every effect records its state, even once a change has been found
+	if (next) same = next->unchanged() && same;
+
+	return same;
+
+}
+
+
 /**
  * Create a new white-in palette effect.
  *
@@ -125,6 +176,38 @@ void WhiteInPaletteEffect::apply (unsigned short* shownPalette, bool direct, int
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int WhiteInPaletteEffect::getState () {
+
+	if (whiteness > F1) return F1 + 1;
+	if (whiteness > 0) return whiteness;
+
+	return 0;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void WhiteInPaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	whiteness -= ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
 /**
  * Create a new fade-in palette effect.
  *
@@ -178,6 +261,38 @@ void FadeInPaletteEffect::apply (unsigned short* shownPalette, bool direct, int
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int FadeInPaletteEffect::getState () {
+
+	if (blackness > F1) return F1 + 1;
+	if (blackness > 0) return blackness;
+
+	return 0;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void FadeInPaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	if (blackness > 0) blackness -= ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
 /**
  * Create a new white-out palette effect.
  *
@@ -233,6 +348,38 @@ void WhiteOutPaletteEffect::apply (unsigned short* shownPalette, bool direct, in
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int WhiteOutPaletteEffect::getState () {
+
+	if (whiteness > F1) return F1 + 1;
+	if (whiteness > 0) return whiteness;
+
+	return 0;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void WhiteOutPaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	if (whiteness <= F1) whiteness += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
 /**
  * Create a new fade-out palette effect.
  *
@@ -284,6 +431,38 @@ void FadeOutPaletteEffect::apply (unsigned short* shownPalette, bool direct, int
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int FadeOutPaletteEffect::getState () {
+
+	if (blackness > F1) return F1 + 1;
+	if (blackness > 0) return blackness;
+
+	return 0;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void FadeOutPaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	if (blackness <= F1) blackness += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
 /**
  * Create a new flash-to-colour palette effect.
  *
@@ -356,6 +535,37 @@ void FlashPaletteEffect::apply (unsigned short* shownPalette, bool direct, int m
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int FlashPaletteEffect::getState () {
+
+	if (progress < F1) return progress;
+
+	return F1;
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void FlashPaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	if (progress < F1) progress += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
 /**
  * Create a new colour rotation palette effect.
  *
@@ -414,6 +624,36 @@ void RotatePaletteEffect::apply (unsigned short* shownPalette, bool direct, int
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int RotatePaletteEffect::getState () {
+
+	return FTOI(position);
+
+}
+
+
+/**
+ * Advance the effect without applying it, for frames where its output is
+ * already known.
+ *
+ * @param mspf Ticks per frame
+ */
+void RotatePaletteEffect::skip (int mspf) {
+
+	if (next) next->skip(mspf);
+
+	position -= (mspf * speed) >> 10;
+	while (position < 0) position += ITOF(amount);
+
+	return;
+
+}
+
+
 /**
  * Create a new parallaxing sky background palette effect.
  *
@@ -493,6 +733,23 @@ void SkyPaletteEffect::apply (unsigned short* shownPalette, bool direct, int msp
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int SkyPaletteEffect::getState () {
+
+	int position, y;
+
+	position = viewY + ((canvasH - 33) << 9) - F4;
+	y = ((canvasH - 34) / 100) + 1;
+
+	return (((position * speed) / y) >> 20) % 255;
+
+}
+
+
 /**
  * Create a new 2D parallaxing background palette effect.
  *
@@ -553,6 +810,23 @@ void P2DPaletteEffect::apply (unsigned short* shownPalette, bool direct, int msp
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int P2DPaletteEffect::getState () {
+
+	int x, y;
+
+	x = FTOI(((256 * 32) - FTOI(viewX)) * speed);
+	y = FTOI(((64 * 32) - FTOI(viewY)) * speed);
+
+	return ((y % 8) << 3) + (x % 8);
+
+}
+
+
 /**
  * Create a new 1D parallaxing background palette effect.
  *
@@ -610,6 +884,18 @@ void P1DPaletteEffect::apply (unsigned short* shownPalette, bool direct, int msp
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int P1DPaletteEffect::getState () {
+
+	return FTOI(MUL(viewX + viewY, speed)) % amount;
+
+}
+
+
 /**
  * Create a new water palette effect.
  *
@@ -667,3 +953,24 @@ void WaterPaletteEffect::apply (unsigned short* shownPalette, bool direct, int m
 }
 
 
+/**
+ * Get a value which changes whenever the effect's output would.
+ *
+ * @return The state
+ */
+int WaterPaletteEffect::getState () {
+
+	int position;
+
+	if (!level) return -1;
+
+	position = localPlayer->getLevelPlayer()->getY() - level->getWaterLevel();
+
+	if (position <= 0) return -1;
+	if (position < depth) return DIV(position, depth);
+
+	return F1;
+
+}
+
+
@@ -45,6 +45,9 @@
 #define PE_1D     9 /* Diagonal lines parallaxing background */
 #define PE_WATER  11 /* The deeper below water, the darker it gets */
 
+// State which no effect reports, so a new effect is always seen as changed
+#define PE_NOSTATE -0x7FFFFFFF
+
 
 // Class
 
@@ -53,12 +56,16 @@ class PaletteEffect {
 
 	protected:
 		PaletteEffect* next; ///< Next effect to use
+		int            lastState; ///< State when the chain was last checked
 
 	public:
 		PaletteEffect          (PaletteEffect* nextPE);
 		virtual ~PaletteEffect ();
 
-		virtual void apply (unsigned short* shownPalette, bool direct, int mspf);
+		virtual void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		virtual int  getState ();
+		virtual void skip     (int mspf);
+		bool         unchanged ();
 
 };
 
@@ -72,7 +79,9 @@ class WhiteInPaletteEffect : public PaletteEffect {
 	public:
 		WhiteInPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -86,7 +95,9 @@ class FadeInPaletteEffect : public PaletteEffect {
 	public:
 		FadeInPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -100,7 +111,9 @@ class WhiteOutPaletteEffect : public PaletteEffect {
 	public:
 		WhiteOutPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply  (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -114,7 +127,9 @@ class FadeOutPaletteEffect : public PaletteEffect {
 	public:
 		FadeOutPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -129,7 +144,9 @@ class FlashPaletteEffect : public PaletteEffect {
 	public:
 		FlashPaletteEffect (unsigned char newRed, unsigned char newGreen, unsigned char newBlue, int newDuration, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -145,7 +162,9 @@ class RotatePaletteEffect : public PaletteEffect {
 	public:
 		RotatePaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
+		void skip     (int mspf);
 
 };
 
@@ -161,7 +180,8 @@ class SkyPaletteEffect : public PaletteEffect {
 	public:
 		SkyPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, unsigned short* newSkyPalette, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
 
 };
 
@@ -176,7 +196,8 @@ class P2DPaletteEffect : public PaletteEffect {
 	public:
 		P2DPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
 
 };
 
@@ -191,7 +212,8 @@ class P1DPaletteEffect : public PaletteEffect {
 	public:
 		P1DPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
 
 };
 
@@ -204,7 +226,8 @@ class WaterPaletteEffect : public PaletteEffect {
 	public:
 		WaterPaletteEffect (fixed newDepth, PaletteEffect* nextPE);
 
-		void apply (unsigned short* shownPalette, bool direct, int mspf);
+		void apply    (unsigned short* shownPalette, bool direct, int mspf);
+		int  getState ();
 
 };
 
@@ -40,6 +40,7 @@ Sprite::Sprite(){
 	xOffset = 0;
 	yOffset = 0;
 	pixelsid=INVALID_OBJ;
+	spans=NULL;
 	//palid=INVALID_OBJ;
 }
 
@@ -48,6 +49,7 @@ Sprite::Sprite(){
  * Delete the sprite.
  */
 Sprite::~Sprite(){
+	spriteCache.forget(this);
 	if (pixelsid!=INVALID_OBJ) freeobj(pixelsid);
 	//if(palid!=INVALID_OBJ) freeobj(palid);
 }
@@ -56,9 +58,11 @@ Sprite::~Sprite(){
  * Make the sprite blank.
  */
 void Sprite::clearPixels () {
+	spriteCache.forget(this);
 	if (pixelsid!=INVALID_OBJ) freeobj(pixelsid);
 	//if (palid!=INVALID_OBJ) freeobj(palid);
 	pixelsid=INVALID_OBJ;
+	spans=NULL;
 	initMiniSurface(&pixels,NULL,1,1);
 	//SDL_SetColorKey(pixels, SDL_SRCCOLORKEY, 0);
 	setColKey(&pixels,0);
@@ -84,16 +88,25 @@ void Sprite::setOffset (short int x, short int y) {
  * @param key The transparent pixel value
  */
 void Sprite::setPixels(unsigned char *data, int width, int height, unsigned char key){
+	spriteCache.forget(this);
 	if((width!=0)&&(height!=0)){
+		int spansSize;
+		initMiniSurface(&pixels,data,width,height);
+		setColKey(&pixels,key);
+		spansSize=getSpansSize();
+		// Keep the spans after the pixels, in the same object
 		if (pixelsid==INVALID_OBJ)
-			addobj(width*height,&pixelsid);
+			addobj((width*height)+spansSize,&pixelsid);
 		else
-			resizeobj(pixelsid,width*height);
+			resizeobj(pixelsid,(width*height)+spansSize);
+		if (spansSize)
+			encodeSpans(&pixels,(unsigned char *)objs[pixelsid].ptr+(width*height));
 		memcpy(objs[pixelsid].ptr,data,width*height);
 		initMiniSurface(&pixels,objs[pixelsid].ptr,width,height);
 		//pixels = createSurface(data, width, height);
 		//SDL_SetColorKey(pixels, SDL_SRCCOLORKEY, key);
 		setColKey(&pixels,key);
+		spans=spansSize?pixels.pix+(width*height):NULL;
 	}else{
 		#ifndef CASIO
 			printf("W: %d H: %d\n",width,height);
@@ -104,6 +117,42 @@ void Sprite::setPixels(unsigned char *data, int width, int height, unsigned char
 
 }
 
+/**
+ * Get the amount of memory needed to draw the sprite from spans.
+ *
+ * @return Size of the spans in bytes, or 0 if the sprite is better drawn from its pixels
+ */
+int Sprite::getSpansSize () {
+
+	int size;
+
+	if (!pixels.pix || !(pixels.flags & miniS_COLKEY)) return 0;
+
+	size = encodeSpans(&pixels, NULL);
+
+	// Only worth it for sprites with few runs per row
+	if ((size < 0) || (size > ((pixels.w * pixels.h) >> 2))) return 0;
+
+	return size;
+
+}
+
+
+/**
+ * Build spans for the sprite's current pixels.
+ *
+ * @param buffer Memory to hold the spans, of the size given by getSpansSize()
+ */
+void Sprite::setSpans (unsigned char* buffer) {
+
+	encodeSpans(&pixels, buffer);
+	spans = buffer;
+
+	return;
+
+}
+
+
 /**
  * Get the horizontal offset of the sprite.
  *
@@ -202,12 +251,19 @@ void Sprite::draw (int x, int y, bool includeOffsets){
 		dy += yOffset;
 	}
 	//SDL_BlitSurface(pixels, NULL, canvas, &dst);
-	blitToCanvas(&pixels,dx,dy);
+	if (spans) blitSpansToCanvas(&pixels,spans,dx,dy);
+	else blitToCanvas(&pixels,dx,dy);
 }
 
 
 /**
- * Draw the sprite scaled
+ * Draw the sprite scaled.
+ *
+ * Rather than dividing to find the sprite pixel under each canvas pixel, the
+ * sprite's rows and columns are stepped through by F1 / scale per canvas
+ * pixel, carrying the remainder, which gives the same pixels. The columns
+ * are mapped once for all rows, and a sprite with spans only visits the
+ * canvas pixels covering its opaque runs.
  *
  * @param x The x-coordinate at which to draw the sprite
  * @param y The y-coordinate at which to draw the sprite
@@ -215,12 +271,18 @@ void Sprite::draw (int x, int y, bool includeOffsets){
  */
 void Sprite::drawScaled (int x, int y, fixed scale) {
 
+	unsigned short columns[canvasW];
+	const unsigned char* rowSpans;
 	unsigned char* srcRow;
 	unsigned char* dstRow;
 	unsigned char pixel, key;
 	int width, height, fullWidth, fullHeight;
 	int dstX, dstY;
 	int srcX, srcY;
+	int step, carry, remainder;
+	int row, rowRemainder, spanRow;
+	int runs, start, end, first, last;
+	int count;
 
 	key = pixels.colkey;
 
@@ -233,6 +295,9 @@ void Sprite::drawScaled (int x, int y, fixed scale) {
 	if (y < -(fullHeight >> 1)) return; // Off-screen
 	if (y + (fullHeight >> 1) > canvasH) height = canvasH + (fullHeight >> 1) - y;
 	else height = fullHeight;
+
+	markDamage(x - (fullWidth >> 1), y - (fullHeight >> 1), fullWidth, fullHeight);
+
 	if (y < (fullHeight >> 1)) {
 
 		srcY = (fullHeight >> 1) - y;
@@ -245,32 +310,503 @@ void Sprite::drawScaled (int x, int y, fixed scale) {
 
 	}
 
+	if (x < (fullWidth >> 1)) {
+
+		srcX = (fullWidth >> 1) - x;
+		dstX = 0;
+
+	} else {
+
+		srcX = 0;
+		dstX = x - (fullWidth >> 1);
+
+	}
+
+	// An odd scaled size can reach one pixel past the edge of the canvas
+	if (dstX + width - srcX > canvasW) width = canvasW - dstX + srcX;
+	if (dstY + height - srcY > canvasH) height = canvasH - dstY + srcY;
+
+	if ((srcY >= height) || (srcX >= width)) return;
+
+	// Distance moved through the sprite for each canvas pixel
+	step = F1 / scale;
+	carry = F1 % scale;
+
+
+	// Find the sprite column under each visible canvas column
+	width -= srcX;
+
+	columns[0] = DIV(srcX, scale);
+	remainder = ITOF(srcX) - (columns[0] * scale);
+
+	for (count = 1; count < width; count++) {
+
+		columns[count] = columns[count - 1] + step;
+		remainder += carry;
+
+		if (remainder >= scale) {
+
+			remainder -= scale;
+			columns[count]++;
+
+		}
+
+	}
+
+
+	// Find the first sprite row
+	row = DIV(srcY, scale);
+	rowRemainder = ITOF(srcY) - (row * scale);
+
+	rowSpans = spans;
+	spanRow = 0;
+
 	while (srcY < height) {
 
-		srcRow = ((unsigned char *)(pixels.pix)) + (pixels.w * DIV(srcY, scale));
-		dstRow = ((unsigned char *)(canvas.pix)) + (canvasW * dstY);
+		srcRow = ((unsigned char *)(pixels.pix)) + (pixels.w * row);
+		dstRow = ((unsigned char *)(canvas.pix)) + (canvasW * dstY) + dstX;
+
+		if (rowSpans) {
+
+			// Skip to the sprite row's spans
+			while (spanRow < row) {
 
-		if (x < (fullWidth >> 1)) {
+				rowSpans += 1 + (*rowSpans << 1);
+				spanRow++;
 
-			srcX = (fullWidth >> 1) - x;
-			dstX = 0;
+			}
+
+			runs = *rowSpans;
+			end = 0;
+
+			for (count = 0; count < runs; count++) {
+
+				start = end + rowSpans[1 + (count << 1)];
+				end = start + rowSpans[2 + (count << 1)];
+
+				// The canvas columns whose sprite columns are in the run
+				first = ((start * scale) + 1023) >> 10;
+				last = ((end * scale) + 1023) >> 10;
+
+				if (first < srcX) first = srcX;
+				if (last > srcX + width) last = srcX + width;
+
+				for (first -= srcX, last -= srcX; first < last; first++)
+					dstRow[first] = srcRow[columns[first]];
+
+			}
 
 		} else {
 
-			srcX = 0;
-			dstX = x - (fullWidth >> 1);
+			for (count = 0; count < width; count++) {
+
+				pixel = srcRow[columns[count]];
+				if (pixel != key) dstRow[count] = pixel;
+
+			}
 
 		}
-		while (srcX < width) {
-			pixel = srcRow[DIV(srcX, scale)];
-			if (pixel != key) dstRow[dstX] = pixel;
-			srcX++;
-			dstX++;
-		}
+
 		srcY++;
 		dstY++;
+
+		row += step;
+		rowRemainder += carry;
+
+		if (rowRemainder >= scale) {
+
+			rowRemainder -= scale;
+			row++;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw the sprite scaled to the nearest size kept by the sprite cache.
+ *
+ * @param x The x-coordinate at which to draw the sprite
+ * @param y The y-coordinate at which to draw the sprite
+ * @param scale The amount by which to scale the sprite
+ */
+void Sprite::drawCached (int x, int y, fixed scale) {
+
+	spriteCache.draw(this, x, y, scale);
+
+	return;
+
+}
+
+
+/// Scales a quarter octave apart, from F1 up to F2
+static const fixed quarterScales[4] = {1024, 1218, 1448, 1722};
+
+/// Scales half way between those in quarterScales, and F2
+static const fixed quarterLimits[4] = {1117, 1328, 1579, 1878};
+
+
+/**
+ * Create an empty sprite cache. No memory is taken until it is first needed.
+ */
+SpriteCache::SpriteCache () {
+
+	count = 0;
+	used = 0;
+	clock = 0;
+	poolid = INVALID_OBJ;
+
+	memset(&stats, 0, sizeof(ScaledStats));
+
+	return;
+
+}
+
+
+/**
+ * Find the cached scale nearest to a scale.
+ *
+ * @param scale The scale
+ *
+ * @return Scale bucket, in quarter octaves from F1
+ */
+int SpriteCache::getBucket (fixed scale) {
+
+	int octave, quarter;
+
+	if (scale <= 0) return SCALED_MINBUCKET - 1;
+
+	octave = 0;
+
+	while (scale < F1) {
+
+		scale <<= 1;
+		octave--;
+
+	}
+
+	while (scale >= F2) {
+
+		scale >>= 1;
+		octave++;
+
+	}
+
+	for (quarter = 0; (quarter < 4) && (scale >= quarterLimits[quarter]); quarter++);
+
+	return (octave * 4) + quarter;
+
+}
+
+
+/**
+ * Get the scale of a scale bucket.
+ *
+ * @param bucket Scale bucket, in quarter octaves from F1
+ *
+ * @return The scale
+ */
+fixed SpriteCache::getBucketScale (int bucket) {
+
+	int octave;
+
+	bucket -= SCALED_MINBUCKET;
+	octave = (bucket >> 2) + (SCALED_MINBUCKET / 4);
+
+	if (octave < 0) return quarterScales[bucket & 3] >> -octave;
+
+	return quarterScales[bucket & 3] << octave;
+
+}
+
+
+/**
+ * Take the memory for the images, if there is enough to spare.
+ *
+ * @return Whether or not the cache has memory
+ */
+bool SpriteCache::reserve () {
+
+	struct memstats mem;
+
+	if (poolid != INVALID_OBJ) return true;
+
+	getMemStats(&mem);
+
+	if ((mem.largestFree < SCALED_BYTES + SCALED_RESERVE) ||
+		(mem.objects + SCALED_OBJRESERVE >= MAXOBJ)) return false;
+
+	addobj(SCALED_BYTES, &poolid);
+
+	return true;
+
+}
+
+
+/**
+ * Drop an image, moving those stored after it down to close the gap.
+ *
+ * @param entry The image's index
+ */
+void SpriteCache::remove (int entry) {
+
+	unsigned char* pool;
+	int size, end, index;
+
+	pool = (unsigned char *)(objs[poolid].ptr);
+	size = entries[entry].size;
+	end = entries[entry].offset + size;
+
+	memmove(pool + entries[entry].offset, pool + end, used - end);
+	used -= size;
+
+	count--;
+
+	for (index = entry; index < count; index++) {
+
+		entries[index] = entries[index + 1];
+		entries[index].offset -= size;
+		if (entries[index].spans >= 0) entries[index].spans -= size;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Scale a sprite's image, choosing the same pixels as Sprite::drawScaled().
+ *
+ * @param sprite The sprite
+ * @param dst Memory to hold the scaled image
+ * @param width Width of the scaled image, at most canvasW
+ * @param height Height of the scaled image
+ * @param scale The amount by which to scale the sprite
+ */
+void SpriteCache::render (const Sprite* sprite, unsigned char* dst, int width, int height, fixed scale) {
+
+	unsigned short columns[canvasW];
+	unsigned char* srcRow;
+	int step, carry, remainder;
+	int row, rowRemainder;
+	int x, y;
+
+	step = F1 / scale;
+	carry = F1 % scale;
+
+	columns[0] = 0;
+	remainder = 0;
+
+	for (x = 1; x < width; x++) {
+
+		columns[x] = columns[x - 1] + step;
+		remainder += carry;
+
+		if (remainder >= scale) {
+
+			remainder -= scale;
+			columns[x]++;
+
+		}
+
 	}
+
+	row = 0;
+	rowRemainder = 0;
+
+	for (y = 0; y < height; y++) {
+
+		srcRow = sprite->pixels.pix + (sprite->pixels.w * row);
+
+		for (x = 0; x < width; x++) dst[x] = srcRow[columns[x]];
+
+		dst += width;
+
+		row += step;
+		rowRemainder += carry;
+
+		if (rowRemainder >= scale) {
+
+			rowRemainder -= scale;
+			row++;
+
+		}
+
+	}
+
 	return;
 
 }
 
+
+/**
+ * Draw a sprite scaled to the nearest cached scale, scaling it first if the
+ * cache does not hold it at that scale yet.
+ *
+ * @param sprite The sprite
+ * @param x The x-coordinate at which to draw the centre of the sprite
+ * @param y The y-coordinate at which to draw the centre of the sprite
+ * @param scale The amount by which to scale the sprite
+ */
+void SpriteCache::draw (Sprite* sprite, int x, int y, fixed scale) {
+
+	struct miniSurface image;
+	ScaledSprite* entry;
+	unsigned char* pool;
+	int bucket, width, height, size, spansSize;
+	int index, oldest;
+
+	if (!sprite->pixels.pix) return;
+
+	bucket = getBucket(scale);
+
+	if ((bucket < SCALED_MINBUCKET) || (bucket > SCALED_MAXBUCKET)) {
+
+		// Too small to matter, or too large to keep
+		stats.bypasses++;
+		sprite->drawScaled(x, y, scale);
+
+		return;
+
+	}
+
+	scale = getBucketScale(bucket);
+
+	for (index = 0; index < count; index++) {
+
+		if ((entries[index].sprite == sprite) && (entries[index].bucket == bucket)) break;
+
+	}
+
+	if (index < count) {
+
+		stats.hits++;
+
+	} else {
+
+		width = FTOI(sprite->pixels.w * scale);
+		height = FTOI(sprite->pixels.h * scale);
+
+		if ((width <= 0) || (height <= 0)) return;
+
+		if ((width > canvasW) || (height > canvasH) || (width * height > SCALED_MAXSIZE) || !reserve()) {
+
+			stats.bypasses++;
+			sprite->drawScaled(x, y, scale);
+
+			return;
+
+		}
+
+		// Make room by dropping the images drawn least recently
+		size = width * height;
+
+		while ((count == SCALED_SPRITES) || (used + size > SCALED_BYTES)) {
+
+			oldest = 0;
+
+			for (index = 1; index < count; index++) {
+
+				if (entries[index].lastUse < entries[oldest].lastUse) oldest = index;
+
+			}
+
+			remove(oldest);
+			stats.evictions++;
+
+		}
+
+		pool = (unsigned char *)(objs[poolid].ptr);
+
+		index = count;
+		entry = entries + index;
+		entry->sprite = sprite;
+		entry->bucket = bucket;
+		entry->offset = used;
+		entry->width = width;
+		entry->height = height;
+		entry->spans = -1;
+
+		render(sprite, pool + used, width, height, scale);
+
+		// Keep spans too if they are worth it and there is room
+		initMiniSurface(&image, pool + used, width, height);
+		setColKey(&image, sprite->pixels.colkey);
+		spansSize = encodeSpans(&image, NULL);
+
+		if ((spansSize > 0) && (spansSize <= (size >> 2)) && (used + size + spansSize <= SCALED_BYTES)) {
+
+			encodeSpans(&image, pool + used + size);
+			entry->spans = used + size;
+			size += spansSize;
+
+		}
+
+		entry->size = size;
+		used += size;
+
+		count++;
+		stats.misses++;
+
+	}
+
+	entry = entries + index;
+	entry->lastUse = ++clock;
+
+	pool = (unsigned char *)(objs[poolid].ptr);
+
+	initMiniSurface(&image, pool + entry->offset, entry->width, entry->height);
+	setColKey(&image, sprite->pixels.colkey);
+
+	x -= entry->width >> 1;
+	y -= entry->height >> 1;
+
+	if (entry->spans >= 0) blitSpansToCanvas(&image, pool + entry->spans, x, y);
+	else blitToCanvas(&image, x, y);
+
+	return;
+
+}
+
+
+/**
+ * Drop the images of a sprite that is being changed or deleted.
+ *
+ * @param sprite The sprite
+ */
+void SpriteCache::forget (const Sprite* sprite) {
+
+	int index;
+
+	index = count;
+
+	while (index--) {
+
+		if (entries[index].sprite == sprite) remove(index);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Drop every image and give back the cache's memory.
+ */
+void SpriteCache::flush () {
+
+	if (poolid != INVALID_OBJ) freeobj(poolid);
+
+	poolid = INVALID_OBJ;
+	count = 0;
+	used = 0;
+
+	return;
+
+}
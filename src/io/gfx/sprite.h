@@ -35,7 +35,28 @@
 #include "mem.h"
 #include "surface.h"
 
-// Class
+
+// Constants
+
+// Number of pre-scaled sprites kept by the sprite cache
+#define SCALED_SPRITES 16
+
+// Bytes of heap taken by the sprite cache while in use
+#define SCALED_BYTES (64 * 1024)
+
+// Largest pre-scaled sprite image, in bytes
+#define SCALED_MAXSIZE (SCALED_BYTES >> 2)
+
+// Heap bytes and objects the sprite cache leaves for everything else
+#define SCALED_RESERVE (32 * 1024)
+#define SCALED_OBJRESERVE 8
+
+// Range of cached scales, in quarter octaves either side of F1
+#define SCALED_MINBUCKET -24
+#define SCALED_MAXBUCKET 24
+
+
+// Classes
 
 /// Sprite
 class Sprite{
@@ -44,11 +65,14 @@ class Sprite{
 		int			xOffset; ///< Horizontal offset
 		int			yOffset; ///< Vertical offset
 		objid_t				pixelsid;
+		const unsigned char*	spans; ///< Opaque runs of the image, or NULL
 		Sprite              ();
 		~Sprite             ();
 		void clearPixels    ();
 		void setOffset      (short int x, short int y);
 		void setPixels      (unsigned char* data, int width, int height, unsigned char key);
+		int  getSpansSize   ();
+		void setSpans       (unsigned char* buffer);
 		int  getXOffset     ();
 		int  getYOffset     ();
 		int getWidth()const{
@@ -60,11 +84,71 @@ class Sprite{
 		}
 		void draw           (int x, int y, bool includeOffsets = true);
 		void drawScaled     (int x, int y, fixed scale);
+		void drawCached     (int x, int y, fixed scale);
 		void setPalette     (unsigned short* palette, int start, int amount);
 		void flashPalette   (int index);
 		void restorePalette ();
 
 };
 
+/// A sprite scaled in advance by the sprite cache
+struct ScaledSprite {
+
+	const Sprite* sprite; ///< The sprite that was scaled
+	int           bucket; ///< Scale bucket, in quarter octaves from F1
+	int           offset; ///< Position of the image in the cache
+	int           size; ///< Bytes taken by the image and its spans
+	int           spans; ///< Position of the spans in the cache, or -1
+	short int     width; ///< Width of the image
+	short int     height; ///< Height of the image
+	unsigned int  lastUse; ///< When the image was last drawn
+
+};
+
+/// How well the sprite cache has been doing
+struct ScaledStats {
+
+	unsigned int hits; ///< Draws from an image already in the cache
+	unsigned int misses; ///< Draws that had to scale an image first
+	unsigned int evictions; ///< Images dropped to make room
+	unsigned int bypasses; ///< Draws too large, too small or short of heap to cache
+
+};
+
+/// Keeps sprites scaled to a few fixed sizes, a quarter octave apart, so
+/// zooming sprites can be drawn with plain colour keyed blits. The images
+/// share one heap object, the least recently drawn making way for new ones.
+class SpriteCache {
+
+	private:
+		ScaledSprite entries[SCALED_SPRITES]; ///< Images, in the order they are stored
+		int          count; ///< Number of images
+		int          used; ///< Bytes taken by the images
+		unsigned int clock; ///< Incremented on every cached draw
+		objid_t      poolid; ///< Memory holding the images
+
+		bool reserve ();
+		void remove  (int entry);
+		void render  (const Sprite* sprite, unsigned char* dst, int width, int height, fixed scale);
+
+	public:
+		ScaledStats stats;
+
+		SpriteCache ();
+
+		static int   getBucket      (fixed scale);
+		static fixed getBucketScale (int bucket);
+
+		void draw   (Sprite* sprite, int x, int y, fixed scale);
+		void forget (const Sprite* sprite);
+		void flush  ();
+
+};
+
+
+// Variable
+
+EXTERN SpriteCache spriteCache; ///< Pre-scaled sprites for zooms
+
 #endif
 
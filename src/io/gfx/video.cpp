@@ -36,6 +36,9 @@
 
 #include <stdint.h>
 #include <string.h>
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
 #ifdef CASIO
 	#include <fxcg/display.h>
 	#include "platforms/casio.h"
@@ -55,6 +58,17 @@ Video::Video(){
 	for (count = 0; count < 256; count++)
 		currentPalette[count]=((count&248)<<8)|((count&252)<<3)|((count&248)>>3);
 	canvas.pix=0;
+	composedEffects=NULL;
+#ifdef PRESENT_THREAD
+	presentThread=NULL;
+	presentLock=NULL;
+	presentCond=NULL;
+	screenLock=NULL;
+#endif
+#ifdef PAIR_LUT
+	memset(lastPalette,0,sizeof(lastPalette));
+	pairValid=false;
+#endif
 	return;
 
 }
@@ -73,7 +87,7 @@ Video::~Video(){
  *
  * @return Success
  */
-static uint8_t videoBuf[384 * 216];
+static uint8_t __attribute__((aligned(16))) videoBuf[384 * 216];
 #ifdef CASIO
 bool Video::init(void) {
 #else
@@ -82,9 +96,14 @@ bool Video::init (bool startFullscreen) {
 	int count;
 	for (count = 0; count < 256;++count)
 		currentPalette[count]=((count&248)<<8)|((count&252)<<3)|((count&248)>>3);
-	#ifndef CASIO
+	#if !defined(CASIO) && !defined(BENCHMARK)
 		fullscreen = startFullscreen;
 		if (fullscreen) SDL_ShowCursor(SDL_DISABLE);
+	#elif !defined(CASIO)
+		(void)startFullscreen;
+	#endif
+	#ifdef PRESENT_THREAD
+		startPresenting();
 	#endif
 	if (!resize()) {
 		#ifndef CASIO
@@ -93,7 +112,7 @@ bool Video::init (bool startFullscreen) {
 		return false;
 
 	}
-	#ifndef CASIO
+	#if !defined(CASIO) && !defined(BENCHMARK)
 		SDL_WM_SetCaption("OpenJazz", NULL);
 	#endif
 	initMiniSurface(&canvas, videoBuf, 384, 216);
@@ -118,12 +137,17 @@ bool Video::resize (void) {
 
 #if defined(CAANOO) || defined(WIZ) || defined(GP2X) || defined(DINGOO)
 	screen = SDL_SetVideoMode(320, 240, 8, FULLSCREEN_FLAGS);
-#elif defined(CASIO)
+#elif defined(CASIO) || defined(BENCHMARK)
 	//Do nothing
+#elif defined(PRESENT_THREAD)
+	// Wait for the present thread to finish with the old surface
+	SDL_LockMutex(screenLock);
+	screen = SDL_SetVideoMode(384, 216, 16, fullscreen? FULLSCREEN_FLAGS: WINDOWED_FLAGS);
+	SDL_UnlockMutex(screenLock);
 #else
 	screen = SDL_SetVideoMode(384, 216, 16, fullscreen? FULLSCREEN_FLAGS: WINDOWED_FLAGS);
 #endif
-	#ifndef CASIO
+	#if !defined(CASIO) && !defined(BENCHMARK)
 	if (!screen) return false;
 	#endif
 		//canvasW = screenW;
@@ -286,55 +310,261 @@ static void DoDMAlcdNonblock(void){
 	*DMA0_CHCR_0|=1;//Enable channel0 DMA
 }
 #endif
+#ifdef PRESENT_THREAD
+// Frames waiting to be shown, with the palettes to show them with
+static uint8_t __attribute__((aligned(16))) presentPixels[PRESENT_FRAMES][384 * 216];
+static unsigned short presentPalettes[PRESENT_FRAMES][256];
+#endif
+#ifdef BENCHMARK
+// There is no window, so output is converted into memory and discarded
+static unsigned short headlessScreen[384 * 216];
+#endif
+typedef uint32_t __attribute__((__may_alias__)) flipWord;
+typedef uint16_t __attribute__((__may_alias__)) flipPair;
 /**
- * Draw graphics to screen.
+ * Convert the whole canvas, four pixels at a time.
  *
- * @param mspf Ticks per frame
- * @param paletteEffects Palette effects to use
+ * @param o Output pixels
+ * @param pix Canvas pixels
+ * @param palette Palette to convert through
  */
-void Video::flip (int mspf, PaletteEffect* paletteEffects) {
-	#ifndef CASIO
+static void convertCanvas (flipWord* o, const uint8_t* pix, const unsigned short* palette) {
+	const flipWord* i=(const flipWord *)pix;
+	unsigned int n=(canvasW*canvasH)>>2;
+	uint32_t p;
+	while(n--){
+		p=*i++;
+		#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			o[0]=(palette[p>>24]<<16)|palette[(p>>16)&255];
+			o[1]=(palette[(p>>8)&255]<<16)|palette[p&255];
+		#else
+			o[0]=palette[p&255]|(palette[(p>>8)&255]<<16);
+			o[1]=palette[(p>>16)&255]|(palette[p>>24]<<16);
+		#endif
+		o+=2;
+	}
+}
+#ifdef PAIR_LUT
+/* Each entry holds the output for a pair of canvas pixels, read as one 16-bit
+value. The same formula gives the right order for either byte order. */
+static uint32_t pairLUT[65536];
+/**
+ * Build the pixel pair table for a palette.
+ *
+ * @param palette Palette to convert through
+ */
+static void buildPairLUT (const unsigned short* palette) {
+	unsigned int count;
+	for(count=0;count<65536;++count)
+		pairLUT[count]=palette[count&255]|(palette[count>>8]<<16);
+}
+/**
+ * Convert the whole canvas, two pixels per lookup.
+ *
+ * @param o Output pixels
+ * @param pix Canvas pixels
+ */
+static void convertCanvasPairs (flipWord* o, const uint8_t* pix) {
+	const flipPair* i=(const flipPair *)pix;
+	unsigned int n=(canvasW*canvasH)>>1;
+	#ifdef __AVX2__
+		// Gather eight pairs, sixteen pixels, at once
+		while(n>=8){
+			__m256i idx=_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)i));
+			_mm256_storeu_si256((__m256i *)o,_mm256_i32gather_epi32((const int *)pairLUT,idx,4));
+			i+=8;
+			o+=8;
+			n-=8;
+		}
+	#endif
+	while(n--)
+		*o++=pairLUT[*i++];
+}
+#endif
+/**
+ * Convert a frame and show it.
+ *
+ * @param pix Canvas pixels
+ * @param palette Palette to convert through
+ */
+void Video::show (const unsigned char* pix, const unsigned short* palette) {
+	#if !defined(CASIO) && !defined(BENCHMARK)
 	if(SDL_MUSTLOCK(screen)) SDL_LockSurface(screen);
 	#endif
-	unsigned int x,y;
 	#ifdef CASIO
-		unsigned short *o=(unsigned short *)vramAddress;
+		flipWord *o=(flipWord *)vramAddress;
 		DmaWaitNext();
+	#elif defined(BENCHMARK)
+		flipWord * o=(flipWord *)headlessScreen;
 	#else
-		unsigned short * o=(unsigned short *)screen->pixels;
+		flipWord * o=(flipWord *)screen->pixels;
 	#endif
-	unsigned char * i=canvas.pix;
-	y=canvasH;
-	// Apply palette effects
-	if (paletteEffects) {
-		unsigned short shownPalette[256];
-		/* If the palette is being emulated, compile all palette changes and
-		apply them all at once.
-		If the palette is being used directly, apply all palette effects
-		directly. */
-		memcpy(shownPalette, currentPalette, sizeof(unsigned short) * 256);
-		paletteEffects->apply(shownPalette, !fakePalette, mspf);
-		while(y--){
-			x=canvasW;
-			while(x--)
-				*o++=shownPalette[*i++];
-		}
-	}else{
-		while(y--){
-			x=canvasW;
-			while(x--)
-				*o++=currentPalette[*i++];
+	#ifdef PAIR_LUT
+		/* Building the pair table costs about as much as a conversion, so it is
+		only done once a palette has been shown for two frames in a row */
+		if(memcmp(palette,lastPalette,sizeof(lastPalette))){
+			memcpy(lastPalette,palette,sizeof(lastPalette));
+			convertCanvas(o,pix,palette);
+		}else{
+			if(!pairValid||memcmp(palette,pairPalette,sizeof(pairPalette))){
+				buildPairLUT(palette);
+				memcpy(pairPalette,palette,sizeof(pairPalette));
+				pairValid=true;
+			}
+			convertCanvasPairs(o,pix);
 		}
-	}
+	#else
+		convertCanvas(o,pix,palette);
+	#endif
 	// Show what has been drawn
 	#ifdef CASIO
 		//Bdisp_PutDisp_DD();
 		DoDMAlcdNonblock();
+	#elif defined(BENCHMARK)
+		//Nothing to show
 	#else
 		if(SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
 		SDL_Flip(screen);
 	#endif
 }
+#ifdef PRESENT_THREAD
+/**
+ * Show queued frames until told to stop.
+ *
+ * @param data The video output object
+ *
+ * @return Thread exit code
+ */
+int Video::presentFrames (void* data) {
+	Video* v=(Video *)data;
+	int slot;
+	SDL_LockMutex(v->presentLock);
+	while(true){
+		while(!v->presentQueued&&!v->presentQuit)
+			SDL_CondWait(v->presentCond,v->presentLock);
+		if(!v->presentQueued) break;
+		slot=v->presentFirst;
+		SDL_UnlockMutex(v->presentLock);
+		// The game thread only writes to slots which are not queued
+		SDL_LockMutex(v->screenLock);
+		v->show(presentPixels[slot],presentPalettes[slot]);
+		SDL_UnlockMutex(v->screenLock);
+		SDL_LockMutex(v->presentLock);
+		v->presentFirst=(slot+1)%PRESENT_FRAMES;
+		v->presentQueued--;
+		SDL_CondSignal(v->presentCond);
+	}
+	SDL_UnlockMutex(v->presentLock);
+	return 0;
+}
+/**
+ * Start converting and showing frames on a separate thread.
+ */
+void Video::startPresenting (void) {
+	presentFirst=0;
+	presentQueued=0;
+	presentQuit=false;
+	presentThread=NULL;
+	screenLock=SDL_CreateMutex();
+	presentLock=SDL_CreateMutex();
+	presentCond=SDL_CreateCond();
+	if(presentLock&&presentCond)
+		presentThread=SDL_CreateThread(presentFrames,this);
+	// Without the thread, frames are shown from flip() as before
+	if(!presentThread) logError("Could not start present thread", SDL_GetError());
+}
+/**
+ * Show any queued frames, then stop the present thread.
+ */
+void Video::stopPresenting (void) {
+	if(presentThread){
+		SDL_LockMutex(presentLock);
+		presentQuit=true;
+		SDL_CondSignal(presentCond);
+		SDL_UnlockMutex(presentLock);
+		SDL_WaitThread(presentThread,NULL);
+		presentThread=NULL;
+	}
+	if(presentCond) SDL_DestroyCond(presentCond);
+	if(presentLock) SDL_DestroyMutex(presentLock);
+	if(screenLock) SDL_DestroyMutex(screenLock);
+	presentCond=NULL;
+	presentLock=NULL;
+	screenLock=NULL;
+}
+/**
+ * Fetch the next pending system event.
+ *
+ * The output surface and the event queue share a connection to the display
+ * on some systems, so they are not used at the same time.
+ *
+ * @param event Receives the event
+ *
+ * @return Whether or not there was an event
+ */
+bool Video::pollEvent (SDL_Event *event) {
+	bool ret;
+	SDL_LockMutex(screenLock);
+	ret=SDL_PollEvent(event);
+	SDL_UnlockMutex(screenLock);
+	return ret;
+}
+#endif
+/**
+ * Draw graphics to screen.
+ *
+ * @param mspf Ticks per frame
+ * @param paletteEffects Palette effects to use
+ */
+void Video::flip (int mspf, PaletteEffect* paletteEffects) {
+	const unsigned short* palette=currentPalette;
+	bool idle;
+	// Apply palette effects
+	if (paletteEffects) {
+		/* Every effect is asked whether its output would change, so that a
+		static screen or an idle level reuses the previous pass (and with it
+		the pixel pair table). The time still has to move on. */
+		idle=paletteEffects->unchanged();
+		if(idle&&(paletteEffects==composedEffects)&&
+			!memcmp(currentPalette,composedBase,sizeof(composedBase))){
+			paletteEffects->skip(mspf);
+		}else{
+			/* If the palette is being emulated, compile all palette changes and
+			apply them all at once.
+			If the palette is being used directly, apply all palette effects
+			directly. */
+			memcpy(composedBase, currentPalette, sizeof(unsigned short) * 256);
+			memcpy(composedPalette, currentPalette, sizeof(unsigned short) * 256);
+			paletteEffects->apply(composedPalette, !fakePalette, mspf);
+			composedEffects=paletteEffects;
+		}
+		palette=composedPalette;
+	}
+	#ifdef PRESENT_THREAD
+		if(presentThread){
+			int slot;
+			/* The canvas keeps its contents for the next frame's dirty tile
+			drawing, so it is copied into a free slot rather than handed over */
+			SDL_LockMutex(presentLock);
+			while(presentQueued==PRESENT_FRAMES)
+				SDL_CondWait(presentCond,presentLock);
+			slot=(presentFirst+presentQueued)%PRESENT_FRAMES;
+			SDL_UnlockMutex(presentLock);
+			memcpy(presentPixels[slot],canvas.pix,canvasW*canvasH);
+			memcpy(presentPalettes[slot],palette,sizeof(unsigned short)*256);
+			SDL_LockMutex(presentLock);
+			presentQueued++;
+			SDL_CondSignal(presentCond);
+			SDL_UnlockMutex(presentLock);
+			return;
+		}
+		SDL_LockMutex(screenLock);
+		show(canvas.pix,palette);
+		SDL_UnlockMutex(screenLock);
+	#else
+		show(canvas.pix,palette);
+	#endif
+}
 
 
 /**
@@ -351,6 +581,8 @@ void Video::clearScreen (int index) {
 	memset(canvas.pix, index, canvasW * canvasH);
 #endif
 
+	markDamage(0, 0, canvasW, canvasH);
+
 	return;
 
 }
@@ -386,6 +618,7 @@ void drawRect (int x, int y, int width, int height, int index) {
 		width=canvasW-x;
 	if(height>(canvasH-y))
 		height=canvasH-y;
+	markDamage(x,y,width,height);
 	unsigned char * p=canvas.pix+x+(y*canvasW);
 	while(height--){
 		memset(p,index,width);
@@ -52,6 +52,19 @@
 	#define FULLSCREEN_FLAGS (SDL_FULLSCREEN | SDL_DOUBLEBUF | SDL_HWSURFACE | SDL_HWPALETTE)
 #endif
 
+// The two-pixel conversion table takes 256KB, too much for the Prizm
+#ifndef CASIO
+	#define PAIR_LUT
+#endif
+
+/* On the desktop, finished frames are queued for a separate thread to convert
+and show. SDL 1.2 on Mac OS X can only draw from the main thread. */
+#if !defined(CASIO) && !defined(BENCHMARK) && !defined(__APPLE__) && !defined(NO_PRESENT_THREAD)
+	#define PRESENT_THREAD
+	// Frames which can be waiting to be shown, besides the one being drawn
+	#define PRESENT_FRAMES 2
+#endif
+
 #ifdef SCALE
 	#define MIN_SCALE 1
 	#define MAX_SCALE 4
@@ -73,6 +86,23 @@ class Video {
 		
 		unsigned short	finalPalette[256];
 		bool			fakePalette; ///< Whether or not the palette mode is being emulated
+		unsigned short	composedPalette[256]; ///< Result of the last palette effect pass
+		unsigned short	composedBase[256]; ///< Palette the last palette effect pass started from
+		PaletteEffect*	composedEffects; ///< Palette effects used by the last pass
+#ifdef PAIR_LUT
+		unsigned short	lastPalette[256]; ///< Palette shown by the previous frame
+		unsigned short	pairPalette[256]; ///< Palette the pixel pair table was built from
+		bool			pairValid; ///< Whether or not the pixel pair table has been built
+#endif
+#ifdef PRESENT_THREAD
+		SDL_Thread*  presentThread; ///< Converts and shows queued frames
+		SDL_mutex*   presentLock; ///< Guards the frame queue
+		SDL_cond*    presentCond; ///< Signalled when the frame queue changes
+		SDL_mutex*   screenLock; ///< Held while the output surface is in use
+		int          presentFirst; ///< Oldest queued frame
+		int          presentQueued; ///< Number of queued frames
+		bool         presentQuit; ///< Whether or not the present thread should stop
+#endif
 #ifdef SCALE
 		int          scaleFactor; ///< Scaling factor
 #endif
@@ -81,6 +111,11 @@ class Video {
 #endif
 
 		void expose            ();
+		void show              (const unsigned char* pix, const unsigned short* palette);
+#ifdef PRESENT_THREAD
+		static int presentFrames (void* data);
+		void startPresenting   (void);
+#endif
 
 	public:
 		unsigned short	currentPalette[256];
@@ -108,6 +143,10 @@ class Video {
 		#ifndef CASIO
 			void       update                (SDL_Event *event);
 		#endif
+#ifdef PRESENT_THREAD
+		bool       pollEvent             (SDL_Event *event);
+		void       stopPresenting        (void);
+#endif
 		void       flip                  (int mspf, PaletteEffect* paletteEffects);
 
 		void       clearScreen           (int index);
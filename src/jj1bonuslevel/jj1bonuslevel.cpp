@@ -45,6 +45,9 @@
 	#include <alloca.h>
 	#include "platforms/casio.h"
 #endif
+#ifdef BENCHMARK
+	#include "benchmark.h"
+#endif
 
 /**
  * Load sprites.
@@ -157,12 +160,18 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 
 	// Load background
 	{
-	unsigned char pixels[832 * 20];
-	file->loadRLE(832 * 20,pixels);
+	RLEDecoder decoder(file);
 	//sorted = new unsigned char[512 * 20];
 	addobj(512*20,&backgroundid);
 	sorted=(unsigned char *)objs[backgroundid].ptr;
-	for (count = 0; count < 20; count++) memcpy(sorted + (count * 512), pixels + (count * 832), 512);
+	// Only the first 512 pixels of each 832 pixel row are used
+	for (count = 0; count < 20; count++) {
+
+		decoder.decode(sorted + (count * 512), 512);
+		decoder.skip(832 - 512);
+
+	}
+	decoder.finish();
 
 	//background = createSurface(sorted, 512, 20);
 	initMiniSurface(&background,sorted,512,20);
@@ -205,6 +214,87 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 }
 
 
+/**
+ * Create the look-up tables used when drawing: the distance to the floor in
+ * each row, which depends only on the canvas height, and on the Casio, which
+ * has no hardware divide, the reciprocals of whole pixel distances.
+ */
+void JJ1BonusLevel::createTables () {
+
+	int count;
+
+	for (count = 0; count < BFLOORROWS; count++)
+		floorDistance[count] = DIV(ITOF(800), ITOF(92) - (ITOF((count + 1) * 84) / ((canvasH >> 1) - 16)));
+
+#ifdef CASIO
+	reciprocals[0] = 0;
+
+	for (count = 1; count < BRECIPS; count++)
+		reciprocals[count] = (1 << 30) / ITOF(count);
+#endif
+
+	return;
+
+}
+
+
+#ifdef CASIO
+/**
+ * Find the approximate reciprocal of a distance, for use with divide().
+ *
+ * @param y The distance
+ *
+ * @return 2^30 divided by the distance, or 0 if the distance is outside the
+ * table
+ */
+unsigned int JJ1BonusLevel::getReciprocal (fixed y) {
+
+	int index;
+
+	index = FTOI(y);
+
+	if ((index < 1) || (index >= BRECIPS - 1)) return 0;
+
+	// Interpolate between the reciprocals of the whole pixels either side
+	return reciprocals[index] -
+		(((reciprocals[index] - reciprocals[index + 1]) * (y & 1023)) >> 10);
+
+}
+
+
+/**
+ * Divide using a reciprocal from getReciprocal(), giving exactly the same
+ * result as DIV(x, y) but without dividing.
+ *
+ * @param x The dividend
+ * @param y The divisor, which must be positive
+ * @param reciprocal The divisor's reciprocal
+ *
+ * @return The quotient
+ */
+fixed JJ1BonusLevel::divide (fixed x, fixed y, unsigned int reciprocal) {
+
+	int numerator, quotient, remainder;
+
+	if (!reciprocal) return DIV(x, y);
+
+	numerator = ITOF((x < 0)? -x: x);
+
+	// Estimate the quotient, then refine the estimate using the remainder
+	quotient = ((unsigned long long)numerator * reciprocal) >> 30;
+	remainder = numerator - (quotient * y);
+	quotient += ((long long)remainder * reciprocal) >> 30;
+
+	// Correct the rounding of the estimate
+	while (quotient * y > numerator) quotient--;
+	while ((quotient + 1) * y <= numerator) quotient++;
+
+	return (x < 0)? -quotient: quotient;
+
+}
+#endif
+
+
 /**
  * Create a JJ1 bonus level.
  *
@@ -278,6 +368,8 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName) : Level(owner) {
 
 	if (x != E_NONE) throw x;
 
+	createTables();
+
 
 	// Load music
 
@@ -390,6 +482,9 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName) : Level(owner) {
  */
 JJ1BonusLevel::~JJ1BonusLevel () {
 
+	// The zoomed sprites are about to go
+	spriteCache.flush();
+
 	// Restore panelBigFont palette
 	panelBigFont->restorePalette();
 	if(tileSetid!=INVALID_OBJ)
@@ -407,6 +502,117 @@ JJ1BonusLevel::~JJ1BonusLevel () {
 }
 
 
+/**
+ * Find the event sprites near the player that can be seen, and sort them from
+ * the furthest to the nearest.
+ *
+ * @param playerSin Sine of the player's direction
+ * @param playerCos Cosine of the player's direction
+ *
+ * @return The number of sprites found
+ */
+int JJ1BonusLevel::findSprites (fixed playerSin, fixed playerCos) {
+
+	BonusSprite candidate;
+	Sprite* sprite;
+	fixed playerX, playerY, sX, sY, across, divisor;
+	int x, y, cellX, cellY, count, found;
+
+	playerX = localPlayer->getJJ1BonusLevelPlayer()->getX();
+	playerY = localPlayer->getJJ1BonusLevelPlayer()->getY();
+
+	found = 0;
+
+	for (y = -BVIEW; y < BVIEW; y++) {
+
+		// The window is shifted a grid element towards the view
+		cellY = ((direction - FQ) & 512)? y: -y;
+
+		for (x = -BVIEW; x < BVIEW; x++) {
+
+			cellX = (direction & 512)? x: -x;
+
+			switch (gridEvents[(cellY + FTOT(playerY)) & 255][(cellX + FTOT(playerX)) & 255]) {
+
+				case 0: // No event
+
+					continue;
+
+				case 1: // Extra time
+
+					sprite = spriteSet + 46;
+
+					break;
+
+				case 2: // Gem
+
+					sprite = spriteSet + 47;
+
+					break;
+
+				case 3: // Hand
+
+					sprite = spriteSet + 48;
+
+					break;
+
+				case 4: // Exit
+
+					sprite = spriteSet + 49;
+
+					break;
+
+				case 5: // Bounce
+
+					sprite = spriteSet + 50;
+
+					break;
+
+				default:
+
+					sprite = spriteSet + 14;
+
+					break;
+
+			}
+
+			sX = TTOF(cellX) + F16 - (playerX & 32767);
+			sY = TTOF(cellY) + F16 - (playerY & 32767);
+
+			divisor = F16 + MUL(sX, playerSin) - MUL(sY, playerCos);
+
+			// Skip events behind, or too close to, the viewer
+			if (FTOI(divisor) <= 8) continue;
+
+			across = MUL(sX, playerCos) + MUL(sY, playerSin);
+
+			// Skip events beyond the sides of the view. Their centres are
+			// across * canvasW / divisor pixels from the middle, and their
+			// half-widths sprite width * F64 * canvasW / (SW * 2 * divisor)
+			if ((long long)abs(across) * canvasW >=
+				((long long)divisor * ((canvasW >> 1) + 2)) +
+				((long long)sprite->getWidth() * F64 * canvasW / (SW * 2))) continue;
+
+			// Insert the event into the list, keeping the furthest first
+			candidate.sprite = sprite;
+			candidate.across = across;
+			candidate.divisor = divisor;
+
+			for (count = found; (count > 0) && (visible[count - 1].divisor < divisor); count--)
+				visible[count] = visible[count - 1];
+
+			visible[count] = candidate;
+			found++;
+
+		}
+
+	}
+
+	return found;
+
+}
+
+
 /**
  * Determine whether or not the given point is in the event area of its tile.
  *
@@ -533,12 +739,16 @@ void JJ1BonusLevel::draw() {
 
 	JJ1BonusLevelPlayer *bonusPlayer;
 	unsigned char* row;
-	Sprite* sprite;
+	unsigned char* tile;
 	//SDL_Rect dst;
 	fixed playerX, playerY, playerSin, playerCos;
 	fixed distance, fwdX, fwdY, nX, sideX, sideY;
-	int levelX, levelY;
-	int x, y;
+#ifdef CASIO
+	unsigned int reciprocal;
+#endif
+	int acrossX, acrossY, stepX, stepY, carry, nXStep, nXCarry;
+	int levelX, levelY, tileX, tileY;
+	int x, y, found;
 
 
 	// Draw the background
@@ -568,10 +778,15 @@ void JJ1BonusLevel::draw() {
 	playerSin = fSin(direction);
 	playerCos = fCos(direction);
 
+	// Across each row, the fraction of the canvas width covered, ITOF(x) /
+	// canvasW, grows by nXStep per pixel plus one whenever the remainder
+	// carries, so the positions can be found by addition alone
+	nXStep = F1 / canvasW;
+	nXCarry = F1 % canvasW;
 
 	for (y = 1; y <= (canvasH >> 1) - 15; y++) {
 
-		distance = DIV(ITOF(800), ITOF(92) - (ITOF(y * 84) / ((canvasH >> 1) - 16)));
+		distance = floorDistance[y - 1];
 		sideX = MUL(distance, playerCos);
 		sideY = MUL(distance, playerSin);
 		fwdX = playerX + MUL(distance - F16, playerSin) - (sideX >> 1);
@@ -579,89 +794,72 @@ void JJ1BonusLevel::draw() {
 
 		row = ((unsigned char *)(canvas.pix)) + (canvasW * (canvasH - y));
 
-		for (x = 0; x < canvasW; x++) {
-
-			nX = ITOF(x) / canvasW;
-
-			levelX = FTOI(fwdX + MUL(nX, sideX));
-			levelY = FTOI(fwdY + MUL(nX, sideY));
-
-			*row++ = tileSet.pix[(gridTiles[ITOT(levelY) & 255][ITOT(levelX) & 255] << 10) + ((levelY & 31) * tileSet.w) + (levelX & 31)];
-
-		}
-
-	}
-
-
-
-	// Draw nearby events
-
-	for (y = -6; y < 6; y++) {
-
-		fixed sY = TTOF(((direction - FQ) & 512)? y: -y) + F16 - (playerY & 32767);
-
-		for (x = -6; x < 6; x++) {
-
-			fixed sX = TTOF((direction & 512)? x: -x) + F16 - (playerX & 32767);
+		// acrossX and acrossY hold nX * sideX and nX * sideY
+		acrossX = 0;
+		acrossY = 0;
+		stepX = nXStep * sideX;
+		stepY = nXStep * sideY;
+		carry = 0;
 
-			fixed divisor = F16 + MUL(sX, playerSin) - MUL(sY, playerCos);
+		// Look up the row's first tile, as any tile can be the first
+		tileX = ITOT(FTOI(fwdX));
+		tileY = ITOT(FTOI(fwdY));
+		tile = tileSet.pix + (gridTiles[tileY & 255][tileX & 255] << 10);
 
-			if (FTOI(divisor) > 8) {
-
-				switch (gridEvents[((((direction - FQ) & 512)? y: -y) + FTOT(playerY)) & 255][(((direction & 512)? x: -x) + FTOT(playerX)) & 255]) {
-
-					case 0: // No event
-
-						sprite = NULL;
-
-						break;
-
-					case 1: // Extra time
+		for (x = 0; x < canvasW; x++) {
 
-						sprite = spriteSet + 46;
+			levelX = FTOI(fwdX + (acrossX >> 10));
+			levelY = FTOI(fwdY + (acrossY >> 10));
 
-						break;
+			// Only look up the tile when moving into another one
+			if ((ITOT(levelX) != tileX) || (ITOT(levelY) != tileY)) {
 
-					case 2: // Gem
+				tileX = ITOT(levelX);
+				tileY = ITOT(levelY);
+				tile = tileSet.pix + (gridTiles[tileY & 255][tileX & 255] << 10);
 
-						sprite = spriteSet + 47;
+			}
 
-						break;
+			*row++ = tile[((levelY & 31) * tileSet.w) + (levelX & 31)];
 
-					case 3: // Hand
+			acrossX += stepX;
+			acrossY += stepY;
+			carry += nXCarry;
 
-						sprite = spriteSet + 48;
+			if (carry >= canvasW) {
 
-						break;
+				carry -= canvasW;
+				acrossX += sideX;
+				acrossY += sideY;
 
-					case 4: // Exit
+			}
 
-						sprite = spriteSet + 49;
+		}
 
-						break;
+	}
 
-					case 5: // Bounce
 
-						sprite = spriteSet + 50;
 
-						break;
+	// Draw nearby events, furthest first so that nearer ones cover them
 
-					default:
+	found = findSprites(playerSin, playerCos);
 
-						sprite = spriteSet + 14;
+	for (x = 0; x < found; x++) {
 
-						break;
+		//dst.x = FTOI(nX * canvasW) + (canvasW >> 1);
+		//dst.y = canvasH >> 1;
+#ifdef CASIO
+		// Without a hardware divide, share one reciprocal between both
+		reciprocal = getReciprocal(visible[x].divisor);
+		nX = divide(visible[x].across, visible[x].divisor, reciprocal);
+		visible[x].sprite->drawCached(FTOI(nX * canvasW) + (canvasW >> 1), canvasH >> 1, divide(F64 * canvasW / SW, visible[x].divisor, reciprocal));
+#else
+		nX = DIV(visible[x].across, visible[x].divisor);
+		visible[x].sprite->drawCached(FTOI(nX * canvasW) + (canvasW >> 1), canvasH >> 1, DIV(F64 * canvasW / SW, visible[x].divisor));
+#endif
 
-				}
-				if (sprite){
-					nX = DIV(MUL(sX, playerCos) + MUL(sY, playerSin), divisor);
-					//dst.x = FTOI(nX * canvasW) + (canvasW >> 1);
-					//dst.y = canvasH >> 1;
-					sprite->drawScaled(FTOI(nX * canvasW) + (canvasW >> 1), canvasH >> 1, DIV(F64 * canvasW / SW, divisor));
-				}
-			}
-		}
 	}
+
 	// Show the player
 	bonusPlayer->draw(ticks);
 	// Show gem count
@@ -770,3 +968,47 @@ int JJ1BonusLevel::play () {
 	}
 	return E_NONE;
 }
+
+
+#ifdef BENCHMARK
+/**
+ * Draw the level without waiting for the clock, turning a little every frame,
+ * and time each frame.
+ *
+ * @param frames Number of frames to draw
+ * @param bench Collector for the frame timings
+ *
+ * @return Error code
+ */
+int JJ1BonusLevel::benchmark (int frames, Benchmark* bench) {
+
+	unsigned int drawStart, flipStart, flipEnd;
+	int frame;
+
+	ticks = T_STEP;
+
+	video.setPalette(palette);
+
+	for (frame = 0; frame < frames; frame++) {
+
+		// Turn through a full circle every 256 frames
+		direction += 4;
+
+		drawStart = benchTime();
+
+		draw();
+
+		flipStart = benchTime();
+
+		video.flip(T_FRAME, paletteEffects);
+
+		flipEnd = benchTime();
+
+		bench->addFrame(0, 0, flipStart - drawStart, flipEnd - flipStart);
+
+	}
+
+	return E_NONE;
+
+}
+#endif
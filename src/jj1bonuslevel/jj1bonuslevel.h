@@ -28,6 +28,7 @@
 #include "level/level.h"
 
 #include "io/gfx/anim.h"
+#include "io/gfx/video.h"
 #ifndef CASIO
 #include <SDL/SDL.h>
 #endif
@@ -40,10 +41,32 @@
 #define BLH    256 /* Bonus level height */
 #define BANIMS  32
 
+// Look-up tables
+#define BFLOORROWS ((canvasH >> 1) - 15) /* Rows of floor drawn */
+#ifdef CASIO
+	#define BRECIPS 512 /* Reciprocals of distances of whole pixels */
+#endif
+
+// Event sprites
+#define BVIEW    6 /* Grid elements either side of the player in which events are shown */
+#define BSPRITES ((BVIEW * 2) * (BVIEW * 2))
+
+// Datatype
+
+/// JJ1 bonus level event sprite waiting to be drawn
+typedef struct {
+
+	Sprite* sprite;
+	fixed   across; ///< Distance across the view, before perspective
+	fixed   divisor; ///< Distance into the view
+
+} BonusSprite;
+
 #define T_BONUS_END 2000
 
 // Classes
 
+class Benchmark;
 class Font;
 
 /// JJ1 bonus level
@@ -61,12 +84,23 @@ class JJ1BonusLevel : public Level {
 		unsigned char	gridEvents[BLH][BLW]; ///< Level grid
 		char						mask[60][64]; ///< Tile masks (at most 60 tiles, all with 8 * 8 masks)
 		fixed						direction; ///< Player's direction
-
-		int  loadSprites ();
-		int  loadTiles   (char* fileName);
-		bool isEvent     (fixed x, fixed y);
-		int  step        ();
-		void draw        ();
+		fixed						floorDistance[BFLOORROWS]; ///< Distance to the floor shown in each row
+#ifdef CASIO
+		unsigned int				reciprocals[BRECIPS]; ///< 2^30 divided by each whole pixel distance
+#endif
+		BonusSprite					visible[BSPRITES]; ///< Event sprites to draw this frame, furthest first
+
+		int          loadSprites   ();
+		int          loadTiles     (char* fileName);
+		void         createTables  ();
+#ifdef CASIO
+		unsigned int getReciprocal (fixed y);
+		fixed        divide        (fixed x, fixed y, unsigned int reciprocal);
+#endif
+		bool         isEvent       (fixed x, fixed y);
+		int          findSprites   (fixed playerSin, fixed playerCos);
+		int          step          ();
+		void         draw          ();
 
 	public:
 		JJ1BonusLevel  (Game* owner, char* fileName);
@@ -74,6 +108,9 @@ class JJ1BonusLevel : public Level {
 
 		bool checkMask (fixed x, fixed y);
 		int  play      ();
+#ifdef BENCHMARK
+		int  benchmark (int frames, Benchmark* bench);
+#endif
 
 };
 
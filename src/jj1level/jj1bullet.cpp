@@ -41,7 +41,6 @@
 /**
  * Generic bullet constructor.
  *
- * @param nextBullet The next bullet
  * @param sourcePlayer The player that fired the bullet (if any)
  * @param startX The starting x-coordinate of the bullet
  * @param startY The starting y-coordinate of the bullet
@@ -49,9 +48,8 @@
  * @param direction The direction of the bullet
  * @param ticks Time
  */
-JJ1Bullet::JJ1Bullet (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char* bullet, int newDirection, unsigned int ticks) {
+JJ1Bullet::JJ1Bullet (JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char* bullet, int newDirection, unsigned int ticks) {
 
-	next = nextBullet;
 	source = sourcePlayer;
 	set = bullet;
 	direction = newDirection;
@@ -87,11 +85,37 @@ JJ1Bullet::JJ1Bullet (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed
 
 
 /**
- * Delete all bullets.
+ * Delete bullet.
  */
 JJ1Bullet::~JJ1Bullet () {
 
-	if (next) delete next;
+	return;
+
+}
+
+
+/**
+ * Allocate a bullet from the level's bullet pool.
+ *
+ * @param size Size of the bullet
+ *
+ * @return Storage for the bullet
+ */
+void* JJ1Bullet::operator new (size_t size) {
+
+	return level->bulletPool.allocate(size);
+
+}
+
+
+/**
+ * Return a bullet's storage to the level's bullet pool.
+ *
+ * @param bullet The bullet's storage
+ */
+void JJ1Bullet::operator delete (void* bullet) {
+
+	if (level) level->bulletPool.release(bullet);
 
 	return;
 
@@ -101,17 +125,13 @@ JJ1Bullet::~JJ1Bullet () {
 /**
  * Delete this bullet.
  *
- * @return The next bullet
+ * @return NULL, as the bullet no longer exists
  */
 JJ1Bullet* JJ1Bullet::remove () {
 
-	JJ1Bullet* oldNext;
-
-	oldNext = next;
-	next = NULL;
 	delete this;
 
-	return oldNext;
+	return NULL;
 
 }
 
@@ -137,12 +157,8 @@ JJ1LevelPlayer* JJ1Bullet::getSource () {
  */
 JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 
-	JJ1Event* event;
-	int count;
-
-	// Process the next bullet
-	if (next) next = next->step(ticks);
-
+	JJ1Event* found[BP_FOUND];
+	int count, events;
 
 	if (level->getStage() != LS_END) {
 
@@ -168,20 +184,13 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 
 			// Check if an event has been hit
 
-			event = level->getEvents();
-
-			while (event) {
+			events = level->findEvents(x, y,
+				ITOF(sprite->getWidth()), ITOF(sprite->getHeight()), found);
 
-				// Check if the event has been hit
-				if (event->overlap(x, y,
-					ITOF(sprite->getWidth()), ITOF(sprite->getHeight()))) {
+			for (count = 0; count < events; count++) {
 
-					// If the event is hittable, hit it and destroy the bullet
-					if (event->hit(source, 1, ticks)) return remove();
-
-				}
-
-				event = event->getNext();
+				// If the event is hittable, hit it and destroy the bullet
+				if (found[count]->hit(source, 1, ticks)) return remove();
 
 			}
 
@@ -259,8 +268,6 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
  */
 void JJ1Bullet::draw (int change) {
 
-	if (next) next->draw(change);
-
 	// Show the bullet
 	sprite->draw(FTOI(getDrawX(change)), FTOI(getDrawY(change)), false);
 
@@ -33,6 +33,8 @@
 
 #include "OpenJazz.h"
 
+#include <stddef.h>
+
 
 // Constants
 
@@ -63,7 +65,6 @@ class Sprite;
 class JJ1Bullet : public Movable {
 
 	private:
-		JJ1Bullet*      next; ///< The next bullet
 		JJ1LevelPlayer* source; ///< Source player. If NULL, was fired by an event
 		Sprite*         sprite; ///< Sprite
 		signed char*    set; ///< Bullet type properties
@@ -72,10 +73,15 @@ class JJ1Bullet : public Movable {
 
 		JJ1Bullet* remove ();
 
+		friend class JJ1Level;
+
 	public:
-		JJ1Bullet  (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char *bullet, int newDirection, unsigned int ticks);
+		JJ1Bullet  (JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char *bullet, int newDirection, unsigned int ticks);
 		~JJ1Bullet ();
 
+		static void* operator new    (size_t size);
+		static void  operator delete (void* bullet);
+
 		JJ1LevelPlayer* getSource ();
 		JJ1Bullet*      step      (unsigned int ticks);
 		void            draw      (int change);
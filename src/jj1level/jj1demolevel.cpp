@@ -42,14 +42,20 @@
 #include "loop.h"
 #include "util.h"
 
+#ifdef BENCHMARK
+	#include "benchmark.h"
+#endif
+
 
 /**
  * Create a JJ1 demo level.
  *
  * @param owner The current game
  * @param fileName Name of the file containing the macro data.
+ * @param recordedInput Whether the file holds one control code per step
+ * instead of a MACRO.# sequence
  */
-JJ1DemoLevel::JJ1DemoLevel (Game* owner, const char* fileName) : JJ1Level(owner) {
+JJ1DemoLevel::JJ1DemoLevel (Game* owner, const char* fileName, bool recordedInput) : JJ1Level(owner) {
 
 	File* file;
 	char* levelFile;
@@ -81,7 +87,20 @@ JJ1DemoLevel::JJ1DemoLevel (Game* owner, const char* fileName) : JJ1Level(owner)
 	// Difficulty
 	diff = file->loadShort();
 
-	macro = file->loadBlock(1024);
+	// Recorded input runs to the end of the file, macros are always 1024
+	// codes long
+	recorded = recordedInput;
+	macroLength = recorded? file->getSize() - 8: 1024;
+
+	if (macroLength <= 0) {
+
+		delete[] levelFile;
+		delete file;
+		throw E_DATA;
+
+	}
+
+	macro = file->loadBlock(macroLength);
 
 	delete file;
 
@@ -110,6 +129,48 @@ JJ1DemoLevel::~JJ1DemoLevel () {
 }
 
 
+/**
+ * Apply a control code from the macro to the local player.
+ *
+ * @param point Index of the control code
+ *
+ * @return Whether or not the macro is still running
+ */
+bool JJ1DemoLevel::useMacro (int point) {
+
+	unsigned char macroPoint;
+
+	if (point >= macroLength) return false;
+
+	macroPoint = macro[point];
+
+	if (macroPoint & 128) return false;
+
+	if (macroPoint & 1) {
+
+		localPlayer->setControl(C_LEFT, false);
+		localPlayer->setControl(C_RIGHT, false);
+		localPlayer->setControl(C_UP, !(macroPoint & 4));
+
+	} else {
+
+		localPlayer->setControl(C_LEFT, !(macroPoint & 2));
+		localPlayer->setControl(C_RIGHT, macroPoint & 2);
+		localPlayer->setControl(C_UP, false);
+
+	}
+
+	localPlayer->setControl(C_DOWN, macroPoint & 8);
+	localPlayer->setControl(C_FIRE, macroPoint & 16);
+	localPlayer->setControl(C_CHANGE, macroPoint & 32);
+	localPlayer->setControl(C_JUMP, macroPoint & 64);
+	localPlayer->setControl(C_SWIM, macroPoint & 64);
+
+	return true;
+
+}
+
+
 /**
  * Play the demo.
  *
@@ -117,7 +178,6 @@ JJ1DemoLevel::~JJ1DemoLevel () {
  */
 int JJ1DemoLevel::play () {
 
-	unsigned char macroPoint;
 	int ret;
 
 
@@ -142,42 +202,93 @@ int JJ1DemoLevel::play () {
 
 
 		// Use macro
+		if (!recorded && !useMacro((ticks / 76) & 1023)) return E_NONE;
 
-		macroPoint = macro[(ticks / 76) & 1023];
 
-		if (macroPoint & 128) return E_NONE;
+		// Check if level has been won
+		if (getStage() == LS_END) return WON;
+
+
+		// Process frame-by-frame activity
 
-		if (macroPoint & 1) {
+		// Process step
+		while (getTimeChange() >= T_STEP) {
 
-			localPlayer->setControl(C_LEFT, false);
-			localPlayer->setControl(C_RIGHT, false);
-			localPlayer->setControl(C_UP, !(macroPoint & 4));
+			if (recorded && !useMacro(steps)) return E_NONE;
 
-		} else {
+			ret = step();
+			steps++;
 
-			localPlayer->setControl(C_LEFT, !(macroPoint & 2));
-			localPlayer->setControl(C_RIGHT, macroPoint & 2);
-			localPlayer->setControl(C_UP, false);
+			if (ret < 0) return ret;
 
 		}
 
-		localPlayer->setControl(C_DOWN, macroPoint & 8);
-		localPlayer->setControl(C_FIRE, macroPoint & 16);
-		localPlayer->setControl(C_CHANGE, macroPoint & 32);
-		localPlayer->setControl(C_JUMP, macroPoint & 64);
-		localPlayer->setControl(C_SWIM, macroPoint & 64);
 
+		// Handle player reactions
+		if (localPlayer->getJJ1LevelPlayer()->reacted(ticks) == PR_KILLED) return LOST;
 
 
-		// Check if level has been won
+		// Draw the graphics
+
+		draw();
+		drawOverlay(LEVEL_BLACK, false, 0, 0, 0, 0);
+
+
+		font->showString("demo", (canvasW >> 1) - 36, 32);
+
+
+	}
+
+	return E_NONE;
+
+}
+
+
+#ifdef BENCHMARK
+/**
+ * Play the demo without waiting for the clock, timing each frame.
+ *
+ * Every frame advances the level by exactly T_FRAME ticks, so the same input
+ * always produces the same sequence of steps and frames.
+ *
+ * @param frames Number of frames to run
+ * @param bench Collector for the frame timings
+ *
+ * @return Error code
+ */
+int JJ1DemoLevel::benchmark (int frames, Benchmark* bench) {
+
+	unsigned int stepStart, drawStart, flipStart, flipEnd;
+	unsigned int frameSteps;
+	int frame, ret;
+
+
+	globalTicks = 0;
+	tickOffset = globalTicks;
+	ticks = 17;
+	steps = 0;
+
+	video.setPalette(palette);
+
+	for (frame = 0; frame < frames; frame++) {
+
+		globalTicks += T_FRAME;
+
+		timeCalcs();
+
+		if (!recorded && !useMacro((ticks / 76) & 1023)) return E_NONE;
+
 		if (getStage() == LS_END) return WON;
 
 
-		// Process frame-by-frame activity
+		stepStart = benchTime();
+
+		frameSteps = steps;
 
-		// Process step
 		while (getTimeChange() >= T_STEP) {
 
+			if (recorded && !useMacro(steps)) return E_NONE;
+
 			ret = step();
 			steps++;
 
@@ -185,24 +296,30 @@ int JJ1DemoLevel::play () {
 
 		}
 
+		frameSteps = steps - frameSteps;
 
-		// Handle player reactions
 		if (localPlayer->getJJ1LevelPlayer()->reacted(ticks) == PR_KILLED) return LOST;
 
 
-		// Draw the graphics
+		drawStart = benchTime();
 
 		draw();
 		drawOverlay(LEVEL_BLACK, false, 0, 0, 0, 0);
 
 
-		font->showString("demo", (canvasW >> 1) - 36, 32);
+		flipStart = benchTime();
 
+		video.flip(T_FRAME, paletteEffects);
+
+		flipEnd = benchTime();
+
+
+		bench->addFrame(frameSteps, drawStart - stepStart,
+			flipStart - drawStart, flipEnd - flipStart);
 
 	}
 
 	return E_NONE;
 
 }
-
-
+#endif
@@ -73,8 +73,9 @@ JJ1Event* JJ1Bridge::step (unsigned int ticks) {
 	int count;
 	fixed bridgeLength, playerDipX, playerDipY;
 
+	(void)ticks;
 
-	set = prepareStep(ticks);
+	set = prepareStep();
 
 	if (!set) return remove(false);
 
@@ -132,9 +133,6 @@ void JJ1Bridge::draw (unsigned int ticks, int change) {
 	fixed bridgeLength, anchorY, leftDipY, rightDipY;
 
 
-	if (next) next->draw(ticks, change);
-
-
 	// If the event has been removed from the grid, do not show it
 	if (!set) return;
 
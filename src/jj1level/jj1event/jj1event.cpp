@@ -59,11 +59,12 @@ JJ1Event::JJ1Event (unsigned char gX, unsigned char gY) {
 	dx = 0;
 	dy = 0;
 
-	next = level->getEvents();
 	gridX = gX;
 	gridY = gY;
 	flashTime = 0;
 
+	level->setEventActive(gX, gY, true);
+
 	animType = E_NOANIM;
 	anim = NULL;
 	noAnimOffset = false;
@@ -79,11 +80,37 @@ JJ1Event::JJ1Event (unsigned char gX, unsigned char gY) {
 
 
 /**
- * Delete all events
+ * Delete event
  */
 JJ1Event::~JJ1Event () {
 
-	if (next) delete next;
+	return;
+
+}
+
+
+/**
+ * Allocate an event from the level's event pool.
+ *
+ * @param size Size of the event
+ *
+ * @return Storage for the event
+ */
+void* JJ1Event::operator new (size_t size) {
+
+	return level->eventPool.allocate(size);
+
+}
+
+
+/**
+ * Return an event's storage to the level's event pool.
+ *
+ * @param event The event's storage
+ */
+void JJ1Event::operator delete (void* event) {
+
+	if (level) level->eventPool.release(event);
 
 	return;
 
@@ -95,31 +122,29 @@ JJ1Event::~JJ1Event () {
  *
  * @param permanently Whether or not to delete the event from the level
  *
- * @return The next event
+ * @return NULL, as the event no longer exists
  */
 JJ1Event* JJ1Event::remove (bool permanently) {
 
-	JJ1Event *oldNext;
+	JJ1Event *event;
+	int count;
 
 	if (permanently) level->clearEvent(gridX, gridY);
 
-	oldNext = next;
-	next = NULL;
-	delete this;
+	// Another event can come from the same tile, e.g. one created by a bullet
+	for (count = level->countEvents() - 1; count >= 0; count--) {
 
-	return oldNext;
+		event = level->getActiveEvent(count);
 
-}
+		if ((event != this) && event->isFrom(gridX, gridY)) break;
 
+	}
 
-/**
- * Get the next event
- *
- * @return The next event
- */
-JJ1Event * JJ1Event::getNext () {
+	if (count < 0) level->setEventActive(gridX, gridY, false);
+
+	delete this;
 
-	return next;
+	return NULL;
 
 }
 
@@ -291,14 +316,9 @@ void JJ1Event::setAnimFrame (int frame, bool looping) {
 /**
  * Functionality required by all event types on each iteration
  *
- * @param ticks Time
- *
  * @return Animation
  */
-JJ1EventType* JJ1Event::prepareStep (unsigned int ticks) {
-
-	// Process the next event
-	if (next) next = next->step(ticks);
+JJ1EventType* JJ1Event::prepareStep () {
 
 	// If the event has been removed from the grid, destroy it
 	if (!set) return NULL;
@@ -319,22 +339,20 @@ JJ1EventType* JJ1Event::prepareStep (unsigned int ticks) {
 
 
 /**
- * Draw the event's energy bar
+ * Draw the energy bar, if the event is a boss
  *
  * @param ticks Time
+ *
+ * @return Whether or not the event is a boss
  */
-void JJ1Event::drawEnergy (unsigned int ticks) {
+bool JJ1Event::drawEnergy (unsigned int ticks) {
 
 	Anim* miscAnim;
 	int hits;
 
-	if (!set || set->modifier != 8) {
+	if (!set || (set->modifier != 8)) return false;
 
-		if (next) next->drawEnergy(ticks);
-
-		return;
-
-	} else if (set->strength) {
+	if (set->strength) {
 
 		// Draw boss energy bar
 
@@ -358,7 +376,7 @@ void JJ1Event::drawEnergy (unsigned int ticks) {
 
 	}
 
-	return;
+	return true;
 
 }
 
@@ -70,7 +70,6 @@ class JJ1Event : public Movable {
 		void calcDimensions ();
 
 	protected:
-		JJ1Event*     next; ///< Next event
 		JJ1EventType* set; ///< Type
 		Anim*         anim; ///< Current animation
 		fixed         drawnX, drawnY; ///< Current drawing co-ordinates
@@ -85,15 +84,19 @@ class JJ1Event : public Movable {
 		JJ1Event* remove  (bool permanently);
 		void      destroy (unsigned int ticks);
 
+		friend class JJ1Level;
+
 		void setAnimType  (unsigned char type);
 		void setAnimFrame (int frame, bool looping);
 
-		JJ1EventType* prepareStep (unsigned int ticks);
+		JJ1EventType* prepareStep ();
 
 	public:
 		virtual ~JJ1Event ();
 
-		JJ1Event*      getNext        ();
+		static void* operator new    (size_t size);
+		static void  operator delete (void* event);
+
 		bool           hit            (JJ1LevelPlayer *source, int hits, unsigned int ticks);
 		bool           isEnemy        ();
 		bool           isFrom         (unsigned char gX, unsigned char gY);
@@ -101,7 +104,7 @@ class JJ1Event : public Movable {
 
 		virtual JJ1Event* step        (unsigned int ticks) = 0;
 		virtual void      draw        (unsigned int ticks, int change) = 0;
-		void              drawEnergy  (unsigned int ticks);
+		bool              drawEnergy  (unsigned int ticks);
 
 };
 
@@ -82,7 +82,7 @@ JJ1Event* DeckGuardian::step (unsigned int ticks) {
 	int count;
 
 
-	set = prepareStep(ticks);
+	set = prepareStep();
 
 	if (!set) return remove(false);
 
@@ -135,9 +135,6 @@ void DeckGuardian::draw (unsigned int ticks, int change) {
 	Anim* anim;
 
 
-	if (next) next->draw(ticks, change);
-
-
 	// If the event has been removed from the grid, do not show it
 	if (!set) return;
 
@@ -213,7 +210,7 @@ JJ1Event* MedGuardian::step(unsigned int ticks) {
 	fixed sin = fSin(ticks / 2);
 	fixed cos = fCos(ticks / 2);
 
-	set = prepareStep(ticks);
+	set = prepareStep();
 
 	if (!set) return remove(false);
 
@@ -425,8 +422,6 @@ void MedGuardian::draw(unsigned int ticks, int change) {
 	Anim *stageAnim;
 	unsigned char frame;
 
-	if (next) next->draw(ticks, change);
-
 	fixed xChange = getDrawX(change);
 	fixed yChange = getDrawY(change);
 
@@ -588,7 +588,7 @@ JJ1Event* JJ1StandardEvent::step (unsigned int ticks) {
 	int hits;
 
 
-	set = prepareStep(ticks);
+	set = prepareStep();
 	hits = level->getEventHits(gridX, gridY);
 
 	// If the event is off-screen, remove it (permanently if it's been deflected by a shield)
@@ -1023,9 +1023,6 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 	Anim* miscAnim;
 
 
-	if (next) next->draw(ticks, change);
-
-
 	// Uncomment the following to see the raw location
 	/*drawRect(FTOI(getDrawX(change)),
 		FTOI(getDrawY(change) - height), FTOI(width),
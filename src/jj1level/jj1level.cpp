@@ -55,6 +55,8 @@
 #include "mem.h"
 #include "surface.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #ifdef CASIO
 	#include <fxcg/keyboard.h>
@@ -102,6 +104,271 @@ JJ1Level::JJ1Level (Game* owner, char* fileName, bool checkpoint) :
 }
 
 
+/**
+ * Thread a free list through a block of slots.
+ *
+ * @param storage The slots
+ * @param size Bytes per slot
+ * @param count Number of slots
+ *
+ * @return The first free slot, or -1
+ */
+int ObjectPool::link (unsigned char* storage, int size, int count) {
+
+	int slot;
+
+	if (!count) return -1;
+
+	// Each free slot holds the index of the next
+	for (slot = 0; slot < count; slot++)
+		*((int *)(storage + (slot * size))) = slot + 1;
+
+	*((int *)(storage + ((count - 1) * size))) = -1;
+
+	return 0;
+
+}
+
+
+/**
+ * Take a slot from a free list.
+ *
+ * @param storage The slots
+ * @param size Bytes per slot
+ * @param free The first free slot, which is updated
+ *
+ * @return The slot
+ */
+void* ObjectPool::take (unsigned char* storage, int size, int* free) {
+
+	unsigned char* slot;
+
+	slot = storage + (*free * size);
+	*free = *((int *)slot);
+
+	return slot;
+
+}
+
+
+/**
+ * Set up the pool's storage.
+ *
+ * @param storage The storage
+ * @param size Bytes per object
+ * @param count Number of objects
+ * @param spareStorage The storage for objects which do not fit
+ * @param spareBytes Bytes per spare object
+ * @param spareCount Number of spare objects
+ * @param order Room for count + spareCount object pointers
+ */
+void ObjectPool::init (void* storage, int size, int count, void* spareStorage, int spareBytes, int spareCount, void** order) {
+
+	slots = (unsigned char *)storage;
+	slotSize = size;
+	capacity = count;
+	firstFree = link(slots, size, count);
+
+	spares = (unsigned char *)spareStorage;
+	spareSize = spareBytes;
+	spareCapacity = spareCount;
+	firstSpare = link(spares, spareBytes, spareCount);
+
+	objects = order;
+	used = 0;
+	sparesUsed = 0;
+	walked = 0;
+	walkEnd = 0;
+	peak = 0;
+	sparePeak = 0;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not there is room for another object of up to the
+ * pool's slot size.
+ *
+ * @return Whether or not there is room
+ */
+bool ObjectPool::hasRoom () {
+
+	return (firstFree >= 0) || (firstSpare >= 0);
+
+}
+
+
+/**
+ * Take a slot from the pool, and add the object to the end of the order. When
+ * the ordinary slots are full, or the object too large for them, the object
+ * goes in a spare slot instead. Callers check hasRoom() first, so running out
+ * of spare slots as well is fatal.
+ *
+ * @param size Size of the object
+ *
+ * @return The object's storage
+ */
+void* ObjectPool::allocate (size_t size) {
+
+	void* object;
+
+	if ((firstFree >= 0) && ((int)size <= slotSize)) {
+
+		object = take(slots, slotSize, &firstFree);
+
+	} else if ((firstSpare >= 0) && ((int)size <= spareSize)) {
+
+		object = take(spares, spareSize, &firstSpare);
+
+		sparesUsed++;
+		if (sparesUsed > sparePeak) sparePeak = sparesUsed;
+
+	} else {
+
+#ifdef CASIO
+		casioQuit("Out of pool slots");
+#else
+		puts("Out of pool slots");
+		exit(-1);
+#endif
+
+	}
+
+	objects[used++] = object;
+	if (used > peak) peak = used;
+
+	return object;
+
+}
+
+
+/**
+ * Return an object's slot to the pool, and close the gap it leaves in the
+ * order. A walk in progress carries on with the object which followed it.
+ *
+ * @param object The object's storage
+ *
+ * @return Whether or not the object was from the pool
+ */
+bool ObjectPool::release (void* object) {
+
+	int index;
+
+	if (((unsigned char *)object >= slots) &&
+		((unsigned char *)object < slots + (capacity * slotSize))) {
+
+		*((int *)object) = firstFree;
+		firstFree = ((unsigned char *)object - slots) / slotSize;
+
+	} else if (((unsigned char *)object >= spares) &&
+		((unsigned char *)object < spares + (spareCapacity * spareSize))) {
+
+		*((int *)object) = firstSpare;
+		firstSpare = ((unsigned char *)object - spares) / spareSize;
+		sparesUsed--;
+
+	} else return false;
+
+	// Objects usually remove themselves while being walked
+	index = walked - 1;
+
+	if ((index < 0) || (index >= used) || (objects[index] != object)) {
+
+		for (index = used - 1; objects[index] != object; index--);
+
+	}
+
+	used--;
+	memmove(objects + index, objects + index + 1, (used - index) * sizeof(void *));
+
+	if (index < walked) walked--;
+	if (index < walkEnd) walkEnd--;
+
+	return true;
+
+}
+
+
+/**
+ * Get the number of objects in the pool.
+ *
+ * @return The number of objects
+ */
+int ObjectPool::getUsed () {
+
+	return used;
+
+}
+
+
+/**
+ * Get an object by its age.
+ *
+ * @param index The object's position in the order, 0 being the oldest
+ *
+ * @return The object
+ */
+void* ObjectPool::get (int index) {
+
+	return objects[index];
+
+}
+
+
+/**
+ * Start walking the objects, oldest first. Objects added during the walk are
+ * left out of it. There can only be one walk at a time.
+ */
+void ObjectPool::startWalk () {
+
+	walked = 0;
+	walkEnd = used;
+
+	return;
+
+}
+
+
+/**
+ * Get the next object of the walk.
+ *
+ * @return The object (NULL if there are none left)
+ */
+void* ObjectPool::walk () {
+
+	if (walked >= walkEnd) return NULL;
+
+	return objects[walked++];
+
+}
+
+
+/**
+ * Get the most objects there have been in the pool at once.
+ *
+ * @return The number of objects
+ */
+int ObjectPool::getPeak () {
+
+	return peak;
+
+}
+
+
+/**
+ * Get the most spare slots there have been in use at once.
+ *
+ * @return The number of spare slots
+ */
+int ObjectPool::getSparePeak () {
+
+	return sparePeak;
+
+}
+
+
 /**
  * Delete HUD graphical data.
  */
@@ -120,11 +387,16 @@ JJ1Level::~JJ1Level () {
 
 	int count;
 
+	// Nothing else knows the tile grid the damage is recorded against
+	stopDamage();
+
 	// Free events
-	if (events) delete events;
+	while (eventPool.getUsed())
+		getActiveEvent(eventPool.getUsed() - 1)->remove(false);
 
 	// Free bullets
-	if (bullets) delete bullets;
+	while (bulletPool.getUsed())
+		((JJ1Bullet *)bulletPool.get(bulletPool.getUsed() - 1))->remove();
 
 	for (count = 0; count < PATHS; count++) {
 
@@ -144,6 +416,9 @@ JJ1Level::~JJ1Level () {
 	if(eventInfoId!=INVALID_OBJ)
 		freeobj(eventInfoId);
 
+	if(spanSetId!=INVALID_OBJ)
+		freeobj(spanSetId);
+
 	deletePanel();
 
 	delete font;
@@ -178,7 +453,7 @@ bool JJ1Level::checkMaskUp (fixed x, fixed y) {
 	if (ev == 122) return false;
 
 	// Check the mask in the tile in question
-	return mask[ge->tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (getMaskRow(ge->tile, (y >> 12) & 7) >> ((x >> 12) & 7)) & 1;
 
 }
 
@@ -198,7 +473,7 @@ bool JJ1Level::checkMaskDown (fixed x, fixed y) {
 		return true;
 
 	// Check the mask in the tile in question
-	return mask[grid[FTOT(y)][FTOT(x)].tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (getMaskRow(grid[FTOT(y)][FTOT(x)].tile, (y >> 12) & 7) >> ((x >> 12) & 7)) & 1;
 
 }
 
@@ -226,11 +501,422 @@ bool JJ1Level::checkSpikes (fixed x, fixed y) {
 	if (ev != 126) return false;
 
 	// Check the mask in the tile in question
-	return mask[ge->tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (getMaskRow(ge->tile, (y >> 12) & 7) >> ((x >> 12) & 7)) & 1;
+
+}
+
+
+/**
+ * Find how far a point can travel upwards, in steps of F4, before reaching a
+ * point that is solid when travelling upwards. Gives the same result as
+ * calling checkMaskUp() at each step, but tests whole tile columns at once.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate of the first point to check
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the first solid point (steps if none)
+ */
+int JJ1Level::sweepUp (fixed x, fixed y, int steps) {
+
+	GridElement *ge;
+	int count, column, row, bits;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (x > TTOF(LW))) return 0;
+
+	column = (x >> 12) & 7;
+	count = 0;
+
+	while (count < steps) {
+
+		if ((y < 0) || (y > TTOF(LH))) return count;
+
+		ge = grid[FTOT(y)] + FTOT(x);
+		row = (y >> 12) & 7;
+
+		// JJ1Event 122 is one-way
+		if ((eventElms[ge->bgEventID & 0x7FFF].event == 122) ||
+			(getMaskType(ge->tile) == MASK_EMPTY)) bits = 0;
+		else bits = getMaskColumn(ge->tile, column) & ((2 << row) - 1);
+
+		if (bits) {
+
+			// Find the nearest solid row above
+			while (!(bits & (1 << row))) {
+
+				row--;
+				count++;
+
+			}
+
+			return (count < steps)? count: steps;
+
+		}
+
+		// Move to the bottom row of the tile above
+		count += row + 1;
+		y -= (row + 1) * F4;
+
+	}
+
+	return steps;
 
 }
 
 
+/**
+ * Find how far a point can travel downwards, in steps of F4, before reaching
+ * a point that is solid when travelling downwards. Gives the same result as
+ * calling checkMaskDown() at each step, but tests whole tile columns at once.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate of the first point to check
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the first solid point (steps if none)
+ */
+int JJ1Level::sweepDown (fixed x, fixed y, int steps) {
+
+	int count, column, row, bits;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (x > TTOF(LW))) return 0;
+
+	// The first step past the bottom edge of the map is solid, whatever
+	// the tiles in between
+	if ((y <= TTOF(LH)) && (((TTOF(LH) - y) >> 12) < steps))
+		steps = ((TTOF(LH) - y) >> 12) + 1;
+
+	column = (x >> 12) & 7;
+	count = 0;
+
+	while (count < steps) {
+
+		if ((y < 0) || (y > TTOF(LH))) return count;
+
+		row = (y >> 12) & 7;
+		bits = getMaskColumn(grid[FTOT(y)][FTOT(x)].tile, column) >> row;
+
+		if (bits) {
+
+			// Find the nearest solid row below
+			while (!(bits & 1)) {
+
+				bits >>= 1;
+				count++;
+
+			}
+
+			return (count < steps)? count: steps;
+
+		}
+
+		// Move to the top row of the tile below
+		count += 8 - row;
+		y += (8 - row) * F4;
+
+	}
+
+	return steps;
+
+}
+
+
+/**
+ * Find how far a point can travel left, in steps of F4, before reaching a
+ * point that is solid when travelling upwards. Gives the same result as
+ * calling checkMaskUp() at each step, but tests whole tile rows at once.
+ *
+ * @param x X-coordinate of the first point to check
+ * @param y Y-coordinate
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the first solid point (steps if none)
+ */
+int JJ1Level::sweepLeft (fixed x, fixed y, int steps) {
+
+	GridElement *ge;
+	int count, column, row, bits;
+
+	// Anything off the edge of the map is solid
+	if ((y < 0) || (y > TTOF(LH))) return 0;
+
+	row = (y >> 12) & 7;
+	count = 0;
+
+	while (count < steps) {
+
+		if ((x < 0) || (x > TTOF(LW))) return count;
+
+		ge = grid[FTOT(y)] + FTOT(x);
+		column = (x >> 12) & 7;
+
+		// JJ1Event 122 is one-way
+		if ((eventElms[ge->bgEventID & 0x7FFF].event == 122) ||
+			(getMaskType(ge->tile) == MASK_EMPTY)) bits = 0;
+		else bits = getMaskRow(ge->tile, row) & ((2 << column) - 1);
+
+		if (bits) {
+
+			// Find the nearest solid column to the left
+			while (!(bits & (1 << column))) {
+
+				column--;
+				count++;
+
+			}
+
+			return (count < steps)? count: steps;
+
+		}
+
+		// Move to the rightmost column of the tile to the left
+		count += column + 1;
+		x -= (column + 1) * F4;
+
+	}
+
+	return steps;
+
+}
+
+
+/**
+ * Find how far a point can travel right, in steps of F4, before reaching a
+ * point that is solid when travelling upwards. Gives the same result as
+ * calling checkMaskUp() at each step, but tests whole tile rows at once.
+ *
+ * @param x X-coordinate of the first point to check
+ * @param y Y-coordinate
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the first solid point (steps if none)
+ */
+int JJ1Level::sweepRight (fixed x, fixed y, int steps) {
+
+	GridElement *ge;
+	int count, column, row, bits;
+
+	// Anything off the edge of the map is solid
+	if ((y < 0) || (y > TTOF(LH))) return 0;
+
+	// The first step past the right edge of the map is solid, whatever the
+	// tiles in between
+	if ((x <= TTOF(LW)) && (((TTOF(LW) - x) >> 12) < steps))
+		steps = ((TTOF(LW) - x) >> 12) + 1;
+
+	row = (y >> 12) & 7;
+	count = 0;
+
+	while (count < steps) {
+
+		if ((x < 0) || (x > TTOF(LW))) return count;
+
+		ge = grid[FTOT(y)] + FTOT(x);
+		column = (x >> 12) & 7;
+
+		// JJ1Event 122 is one-way
+		if ((eventElms[ge->bgEventID & 0x7FFF].event == 122) ||
+			(getMaskType(ge->tile) == MASK_EMPTY)) bits = 0;
+		else bits = getMaskRow(ge->tile, row) >> column;
+
+		if (bits) {
+
+			// Find the nearest solid column to the right
+			while (!(bits & 1)) {
+
+				bits >>= 1;
+				count++;
+
+			}
+
+			return (count < steps)? count: steps;
+
+		}
+
+		// Move to the leftmost column of the tile to the right
+		count += 8 - column;
+		x += (8 - column) * F4;
+
+	}
+
+	return steps;
+
+}
+
+
+#ifdef BENCHMARK
+/**
+ * Get the next number from a repeatable sequence.
+ *
+ * @param seed The sequence's state
+ *
+ * @return A number from 0 to 2^24 - 1
+ */
+static int checkRand (unsigned int* seed) {
+
+	*seed = (*seed * 1103515245) + 12345;
+
+	return *seed >> 8;
+
+}
+
+
+/**
+ * Pick a coordinate for checkSweeps(): anywhere across the map, near one of
+ * its edges, or near a given tile.
+ *
+ * @param seed The random sequence's state
+ * @param size The map's size, in tiles
+ * @param tile A tile to be near, or -1
+ *
+ * @return The coordinate
+ */
+static fixed checkPosition (unsigned int* seed, int size, int tile) {
+
+	fixed position;
+
+	switch (checkRand(seed) & 3) {
+
+		case 0:
+
+			// Near a chosen tile
+			if (tile >= 0) {
+
+				position = TTOF(tile) - TTOF(2) + (checkRand(seed) % TTOF(5));
+
+				break;
+
+			}
+
+			// Fall through
+
+		case 1:
+
+			// Near the start or the end of the map
+			position = ((checkRand(seed) & 1)? TTOF(size): 0) + (checkRand(seed) % TTOF(4)) - TTOF(2);
+
+			break;
+
+		default:
+
+			// Anywhere, including just beyond the map
+			position = (checkRand(seed) % TTOF(size + 2)) - TTOF(1);
+
+			break;
+
+	}
+
+	// Often start exactly on a pixel of the tile masks
+	if (checkRand(seed) & 1) position &= ~(F4 - 1);
+
+	return position;
+
+}
+
+
+/**
+ * Compare the sweeps with calling checkMaskUp() or checkMaskDown() at each
+ * step, from random points across the map, around its edges and around
+ * one-way tiles (event 122), printing any differences.
+ *
+ * @param points Number of points to try
+ *
+ * @return Number of differences
+ */
+int JJ1Level::checkSweeps (int points) {
+
+	unsigned short oneWay[BP_ENTRIES];
+	unsigned int seed;
+	fixed x, y;
+	int gridX, gridY, oneWays, point, tile, steps, swept, stepped, errors;
+
+	// Find one-way tiles to check around
+	oneWays = 0;
+
+	for (gridY = 0; gridY < LH; gridY++) {
+
+		for (gridX = 0; gridX < LW; gridX++) {
+
+			if ((eventElms[grid[gridY][gridX].bgEventID & 0x7FFF].event == 122) && (oneWays < BP_ENTRIES))
+				oneWay[oneWays++] = (gridY << 8) + gridX;
+
+		}
+
+	}
+
+	seed = 1;
+	errors = 0;
+
+	for (point = 0; point < points; point++) {
+
+		tile = oneWays? oneWay[checkRand(&seed) % oneWays]: -1;
+
+		x = checkPosition(&seed, LW, (tile >= 0)? (tile & 255): -1);
+		y = checkPosition(&seed, LH, (tile >= 0)? (tile >> 8): -1);
+		steps = checkRand(&seed) % 65;
+
+		for (stepped = 0; (stepped < steps) && !checkMaskUp(x, y - (stepped * F4)); stepped++);
+		swept = sweepUp(x, y, steps);
+
+		if (swept != stepped) {
+
+			printf("sweepUp from %d, %d over %d steps: %d, stepping gives %d\n", x, y, steps, swept, stepped);
+			errors++;
+
+		}
+
+		for (stepped = 0; (stepped < steps) && !checkMaskDown(x, y + (stepped * F4)); stepped++);
+		swept = sweepDown(x, y, steps);
+
+		if (swept != stepped) {
+
+			printf("sweepDown from %d, %d over %d steps: %d, stepping gives %d\n", x, y, steps, swept, stepped);
+			errors++;
+
+		}
+
+		for (stepped = 0; (stepped < steps) && !checkMaskUp(x - (stepped * F4), y); stepped++);
+		swept = sweepLeft(x, y, steps);
+
+		if (swept != stepped) {
+
+			printf("sweepLeft from %d, %d over %d steps: %d, stepping gives %d\n", x, y, steps, swept, stepped);
+			errors++;
+
+		}
+
+		for (stepped = 0; (stepped < steps) && !checkMaskUp(x + (stepped * F4), y); stepped++);
+		swept = sweepRight(x, y, steps);
+
+		if (swept != stepped) {
+
+			printf("sweepRight from %d, %d over %d steps: %d, stepping gives %d\n", x, y, steps, swept, stepped);
+			errors++;
+
+		}
+
+	}
+
+	return errors;
+
+}
+
+
+/**
+ * Get the time spent showing the loading screen while the level was loaded.
+ *
+ * @return Time in microseconds
+ */
+unsigned int JJ1Level::getLoadingTime () {
+
+	return loadingTime;
+
+}
+#endif
+
+
 /**
  * Determine the level's world number.
  *
@@ -268,13 +954,221 @@ void JJ1Level::setTile (unsigned char gridX, unsigned char gridY, unsigned char
 
 
 /**
- * Get the active events.
+ * Get the number of active events.
  *
- * @return The first active event
+ * @return The number of active events
  */
-JJ1Event* JJ1Level::getEvents () {
+int JJ1Level::countEvents () {
+
+	return eventPool.getUsed();
+
+}
+
+
+/**
+ * Get an active event by its age.
+ *
+ * @param index The event's position among the active events, 0 being the oldest
+ *
+ * @return The event
+ */
+JJ1Event* JJ1Level::getActiveEvent (int index) {
+
+	return (JJ1Event *)eventPool.get(index);
+
+}
+
+
+/**
+ * Find the broad phase cells covered by an area. Cells beyond the grid are
+ * counted as the edge cells, so that events and bullets beyond it still meet.
+ *
+ * @param left The x-coordinate of the left of the area
+ * @param top The y-coordinate of the top of the area
+ * @param width The width of the area
+ * @param height The height of the area
+ * @param cellLeft Receives the left-most cell
+ * @param cellTop Receives the top cell
+ * @param cellRight Receives the right-most cell
+ * @param cellBottom Receives the bottom cell
+ */
+void JJ1Level::findCells (fixed left, fixed top, fixed width, fixed height, int* cellLeft, int* cellTop, int* cellRight, int* cellBottom) {
+
+	*cellLeft = (FTOI(left) >> BP_SHIFT) - bpX;
+	*cellTop = (FTOI(top) >> BP_SHIFT) - bpY;
+	*cellRight = (FTOI(left + width) >> BP_SHIFT) - bpX;
+	*cellBottom = (FTOI(top + height) >> BP_SHIFT) - bpY;
+
+	if (*cellLeft < 0) *cellLeft = 0;
+	else if (*cellLeft >= BP_W) *cellLeft = BP_W - 1;
+	if (*cellRight < 0) *cellRight = 0;
+	else if (*cellRight >= BP_W) *cellRight = BP_W - 1;
+	if (*cellTop < 0) *cellTop = 0;
+	else if (*cellTop >= BP_H) *cellTop = BP_H - 1;
+	if (*cellBottom < 0) *cellBottom = 0;
+	else if (*cellBottom >= BP_H) *cellBottom = BP_H - 1;
+
+	return;
+
+}
+
+
+/**
+ * Sort the active events into a grid of cells around the viewport, by the
+ * areas they cover, so that a bullet is only tested against nearby events.
+ * Anything beyond the grid goes in the edge cells.
+ */
+void JJ1Level::buildBroadPhase () {
+
+	JJ1Event* event;
+	int order, left, top, right, bottom, x, y;
 
-	return events;
+	for (y = 0; y < BP_H; y++) {
+
+		for (x = 0; x < BP_W; x++) bpCells[y][x] = -1;
+
+	}
+
+	bpEntries = 0;
+	bpFull = false;
+
+	// Leave room around the viewport for events which have not gone yet
+	bpX = (FTOI(viewX) >> BP_SHIFT) - ((BP_W - (canvasW >> BP_SHIFT)) >> 1);
+	bpY = (FTOI(viewY) >> BP_SHIFT) - ((BP_H - (canvasH >> BP_SHIFT)) >> 1);
+
+	// Newest first, as the events have always been searched
+	for (order = 0; order < eventPool.getUsed(); order++) {
+
+		event = getActiveEvent(eventPool.getUsed() - 1 - order);
+
+		findCells(event->drawnX, event->drawnY, event->width, event->height, &left, &top, &right, &bottom);
+
+		if (bpEntries + ((right + 1 - left) * (bottom + 1 - top)) > BP_ENTRIES) {
+
+			bpFull = true;
+
+			return;
+
+		}
+
+		for (y = top; y <= bottom; y++) {
+
+			for (x = left; x <= right; x++) {
+
+				bpEvents[bpEntries] = event;
+				bpOrder[bpEntries] = order;
+				bpNext[bpEntries] = bpCells[y][x];
+				bpCells[y][x] = bpEntries++;
+
+			}
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find the active events overlapping the given area, newest first.
+ *
+ * @param left The x-coordinate of the left of the area
+ * @param top The y-coordinate of the top of the area
+ * @param width The width of the area
+ * @param height The height of the area
+ * @param found Array of BP_FOUND events to receive the events
+ *
+ * @return The number of events found
+ */
+int JJ1Level::findEvents (fixed left, fixed top, fixed width, fixed height, JJ1Event** found) {
+
+	JJ1Event* event;
+	short order[BP_FOUND];
+	int count, entry, cellLeft, cellTop, cellRight, cellBottom, x, y, pos;
+
+	count = 0;
+
+	if (bpFull) {
+
+		// Not every event is in the grid, so check them all
+		for (entry = eventPool.getUsed() - 1; (entry >= 0) && (count < BP_FOUND); entry--) {
+
+			event = getActiveEvent(entry);
+
+			if (event->overlap(left, top, width, height)) found[count++] = event;
+
+		}
+
+		return count;
+
+	}
+
+	findCells(left, top, width, height, &cellLeft, &cellTop, &cellRight, &cellBottom);
+
+	for (y = cellTop; y <= cellBottom; y++) {
+
+		for (x = cellLeft; x <= cellRight; x++) {
+
+			for (entry = bpCells[y][x]; entry >= 0; entry = bpNext[entry]) {
+
+				if (!bpEvents[entry]->overlap(left, top, width, height)) continue;
+
+				// Keep the events newest first, once each
+				for (pos = count; (pos > 0) && (order[pos - 1] > bpOrder[entry]); pos--);
+
+				if ((pos > 0) && (order[pos - 1] == bpOrder[entry])) continue;
+				if (pos == BP_FOUND) continue;
+
+				if (count == BP_FOUND) count--;
+
+				memmove(found + pos + 1, found + pos, (count - pos) * sizeof(JJ1Event*));
+				memmove(order + pos + 1, order + pos, (count - pos) * sizeof(short));
+
+				found[pos] = bpEvents[entry];
+				order[pos] = bpOrder[entry];
+				count++;
+
+			}
+
+		}
+
+	}
+
+	return count;
+
+}
+
+
+/**
+ * Determine whether or not the event from the given tile is active.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ *
+ * @return Whether or not there is an active event from the tile
+ */
+bool JJ1Level::isEventActive (unsigned char gridX, unsigned char gridY) {
+
+	return (activeEvents[gridY][gridX >> 3] >> (gridX & 7)) & 1;
+
+}
+
+
+/**
+ * Record whether or not there is an active event from the given tile.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ * @param active Whether or not there is an active event from the tile
+ */
+void JJ1Level::setEventActive (unsigned char gridX, unsigned char gridY, bool active) {
+
+	if (active) activeEvents[gridY][gridX >> 3] |= 1 << (gridX & 7);
+	else activeEvents[gridY][gridX >> 3] &= ~(1 << (gridX & 7));
+
+	return;
 
 }
 
@@ -485,7 +1379,8 @@ fixed JJ1Level::getWaterLevel () {
 
 
 /**
- * Create new bullet(s) (or event(s), if applicable)
+ * Create new bullet(s) (or event(s), if applicable). When the pool is full,
+ * nothing is fired.
  *
  * @param sourcePlayer The player that fired the bullet (if any)
  * @param gridX The grid x-coordinate of the event that fired the bullet (if any)
@@ -508,24 +1403,23 @@ void JJ1Level::createBullet (JJ1LevelPlayer* sourcePlayer, unsigned char gridX,
 
 	if (set[B_GRAVITY | direction] == 4) {
 
-		events = new JJ1StandardEvent(eventSet + set[B_SPRITE | direction], gridX, gridY, startX, startY + F32);
+		if (eventPool.hasRoom())
+			new JJ1StandardEvent(eventSet + set[B_SPRITE | direction], gridX, gridY, startX, startY + F32);
 
-	} else if (set[B_SPRITE | direction] != 0) {
+	} else if ((set[B_SPRITE | direction] != 0) && bulletPool.hasRoom()) {
 
 		// Create new bullet
-		level->bullets = new JJ1Bullet(level->bullets,
-			sourcePlayer,
+		new JJ1Bullet(sourcePlayer,
 			startX,
 			startY,
 			set,
 			direction,
 			time);
 
-		if (set[B_XSPEED | direction | 2] != 0) {
+		if ((set[B_XSPEED | direction | 2] != 0) && bulletPool.hasRoom()) {
 
 			// Create the other bullet
-			level->bullets = new JJ1Bullet(level->bullets,
-				sourcePlayer,
+			new JJ1Bullet(sourcePlayer,
 				startX,
 				startY,
 				set,
@@ -663,6 +1557,15 @@ int JJ1Level::play () {
 
 				if (timeBonus == -1) {
 
+					// Read the next level while the statistics are shown
+					if (game && (nextLevelNum != 99)) {
+
+						string = createFileName(F_LEVEL, nextLevelNum, nextWorldNum);
+						prefetch(string);
+						delete[] string;
+
+					}
+
 					if (ticks < endTime) timeBonus = ((endTime - ticks) / 60000) * 100;
 					else timeBonus = 0;
 
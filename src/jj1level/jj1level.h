@@ -116,6 +116,28 @@
 #define T_START 500
 #define T_END   1000
 
+// Broad phase for bullet collisions with events
+#define BP_SHIFT    6 /* Cells are 64 pixels square */
+#define BP_W        32
+#define BP_H        24
+#define BP_ENTRIES  256 /* Event entries in the cells */
+#define BP_FOUND    32 /* Events found for one bullet */
+
+// Storage for active events and bullets
+#define EVENT_SLOTS       96
+#define EVENT_SLOT_SIZE   96 /* Bytes, enough for any kind of event */
+#define EVENT_SPARES      16
+#define EVENT_SPARE_SIZE  128 /* Bytes */
+#define BULLET_SLOTS      64
+#define BULLET_SLOT_SIZE  64 /* Bytes, enough for a bullet */
+#define BULLET_SPARES     16
+#define BULLET_SPARE_SIZE 96 /* Bytes */
+
+// Tile mask summaries
+#define MASK_MIXED 0
+#define MASK_EMPTY 1 /* No solid cells */
+#define MASK_SOLID 2 /* All cells solid */
+
 
 // Datatypes
 
@@ -134,6 +156,14 @@ typedef struct __attribute__((packed)) {
 
 } GridEventElement;
 
+/// JJ1 level tile mask, 8 * 8 cells
+typedef union {
+
+	unsigned long long all; ///< Every cell, for testing the whole mask at once
+	unsigned char      rows[8]; ///< One bit per column of each row, leftmost in bit 0
+
+} TileMask;
+
 /// JJ1 level event type
 typedef struct __attribute__((packed)) {
 
@@ -170,22 +200,73 @@ typedef struct {
 
 // Classes
 
+class Benchmark;
 class Font;
 class JJ1Bullet;
 class JJ1Event;
 class JJ1LevelPlayer;
 
+/// Fixed-capacity storage for objects of up to a given size, with a few larger
+/// spare slots for objects which do not fit or arrive when the others are all
+/// in use. The pool also lists its objects in the order in which they were
+/// created, oldest first, with no gaps, so that they can be stepped and drawn
+/// in that order by running along one array. Slots are reused, so the order
+/// of the slots themselves means nothing.
+class ObjectPool {
+
+	private:
+		unsigned char* slots; ///< The storage
+		int            slotSize; ///< Bytes per object
+		int            capacity; ///< Number of objects
+		int            firstFree; ///< First free slot, or -1
+		unsigned char* spares; ///< Storage for objects which do not fit in the slots
+		int            spareSize; ///< Bytes per spare object
+		int            spareCapacity; ///< Number of spare objects
+		int            firstSpare; ///< First free spare slot, or -1
+		void**         objects; ///< The objects, oldest first
+		int            used; ///< Number of objects
+		int            sparesUsed; ///< Number of spare slots in use
+		int            walked; ///< Objects returned by the current walk
+		int            walkEnd; ///< Objects to return in the current walk
+		int            peak; ///< Most objects at once
+		int            sparePeak; ///< Most spare slots in use at once
+
+		static int   link (unsigned char* storage, int size, int count);
+		static void* take (unsigned char* storage, int size, int* free);
+
+	public:
+		void  init         (void* storage, int size, int count, void* spareStorage, int spareBytes, int spareCount, void** order);
+		bool  hasRoom      ();
+		void* allocate     (size_t size);
+		bool  release      (void* object);
+		int   getUsed      ();
+		void* get          (int index);
+		void  startWalk    ();
+		void* walk         ();
+		int   getPeak      ();
+		int   getSparePeak ();
+
+};
+
 /// JJ1 level
 class JJ1Level : public Level {
 
 	private:
 		struct miniSurface  tileSet; ///< Tile images
+		struct miniSurface  solidTileSet; ///< Tile images, without the colour key
+		unsigned int  tileOpaque[240]; ///< Rows of each tile with no transparent pixels, one bit per row
+		unsigned int  tileClear[240]; ///< Rows of each tile with only transparent pixels, one bit per row
 		objid_t			tileSetramid=INVALID_OBJ;
 		objid_t			eventInfoId=INVALID_OBJ;
+		objid_t			spanSetId=INVALID_OBJ; ///< Spans of the sprites that are not on the heap
 		struct miniSurface  panel; ///< HUD background image
 		struct miniSurface  panelAmmo[6]; ///< HUD ammo type images
-		JJ1Event*     events; ///< Active events
-		JJ1Bullet*    bullets; ///< Active bullets
+		unsigned char eventSlots[EVENT_SLOTS * EVENT_SLOT_SIZE] __attribute__((aligned(8))); ///< Storage for the event pool
+		unsigned char eventSpares[EVENT_SPARES * EVENT_SPARE_SIZE] __attribute__((aligned(8))); ///< Spare storage for the event pool
+		void*         eventOrder[EVENT_SLOTS + EVENT_SPARES]; ///< Active events, oldest first
+		unsigned char bulletSlots[BULLET_SLOTS * BULLET_SLOT_SIZE] __attribute__((aligned(8))); ///< Storage for the bullet pool
+		unsigned char bulletSpares[BULLET_SPARES * BULLET_SPARE_SIZE] __attribute__((aligned(8))); ///< Spare storage for the bullet pool
+		void*         bulletOrder[BULLET_SLOTS + BULLET_SPARES]; ///< Active bullets, oldest first
 		//char*         musicFile; ///< Music file name
 		char*         sceneFile; ///< File name of cutscene to play when level has been completed
 		Sprite*       spriteSet; ///< Sprites
@@ -194,8 +275,18 @@ class JJ1Level : public Level {
 		char          playerAnims[JJ1PANIMS]; ///< Default player animations
 		signed char   bulletSet[BULLETS][BLENGTH]; ///< Bullet types
 		JJ1EventType  eventSet[EVENTS]; ///< Event types
-		char          mask[240][64]; ///< Tile masks. At most 240 tiles, all with 8 * 8 masks
+		TileMask      mask[240]; ///< Tile masks. At most 240 tiles
+		unsigned char maskColumns[240][8]; ///< One bit per row of each column of each tile mask, topmost in bit 0
+		unsigned char maskType[240]; ///< Summary of each tile mask (MASK_EMPTY, etc.)
 		GridElement   grid[LH][LW]; ///< Level grid. All levels are the same size
+		unsigned char activeEvents[LH][LW >> 3]; ///< One bit per grid element with an active event
+		JJ1Event*     bpEvents[BP_ENTRIES]; ///< Event of each broad phase entry
+		short         bpOrder[BP_ENTRIES]; ///< Position of each entry's event among the active events, newest first
+		short         bpNext[BP_ENTRIES]; ///< Next entry in the same cell, or -1
+		short         bpCells[BP_H][BP_W]; ///< First entry in each cell, or -1
+		int           bpEntries; ///< Number of entries used
+		int           bpX, bpY; ///< Position of the top-left cell, in cells
+		bool          bpFull; ///< Whether or not some events could not be entered
 		unsigned short	skyPalette[256]; ///< Full palette for sky background
 		bool          sky; ///< Whether or not to use sky background
 		unsigned char skyOrb; ///< The tile to use as the background sun/moon/etc.
@@ -210,14 +301,40 @@ class JJ1Level : public Level {
 		fixed         energyBar; ///< HUD energy bar fullness
 		int           ammoType; ///< HUD ammo type
 		fixed         ammoOffset; ///< HUD ammo offset
+		unsigned int  drawnTiles[DAMAGE_H][DAMAGE_W]; ///< What was drawn in each visible grid cell during the last frame
+		int           drawnX; ///< Horizontal viewport position of the last frame, or -1 to redraw everything
+		int           drawnY; ///< Vertical viewport position of the last frame
+#ifdef SCROLL_LAYER
+		struct miniSurface layer; ///< Background tiles of the last frame
+#endif
 		GridEventElement *eventElms;
 		char* tileFileName;
+#ifdef BENCHMARK
+		unsigned int  loadingTime; ///< Microseconds spent showing the loading screen
+#endif
 
-		void deletePanel  ();
+		void deletePanel        ();
+		void classifyTiles      (int tiles);
+		void buildBroadPhase    ();
+		void drawTile           (int tile, int x, int y);
+		void drawBackgroundTile (int x, int y, int vX, int vY, int fill);
+#ifdef SCROLL_LAYER
+		void scrollLayer        (int dx, int dy, int viewH);
+		void shiftTileKeys      (int dx, int dy);
+#endif
 		int  loadPanel    ();
 		void loadSprite   (File* file, Sprite* sprite);
 		int  loadSprites  (char* fileName);
 		int  loadTiles    (char* fileName);
+		void useTiles     (int tiles);
+		void createGrid     (unsigned char* buffer);
+		void createMaskBits (int tiles);
+		void createPaths    (unsigned char* buffer);
+		void createEventSet (unsigned char* buffer);
+		void createAnims    (unsigned char* buffer);
+		void createEffects  (int type, bool checkpoint);
+		bool loadCache      (char* fileName, unsigned int levelStamp, bool checkpoint);
+		void saveCache      (char* fileName, unsigned int levelStamp);
 
 		GridEventElement* getEventElement(int x, int y) {
 			unsigned eventIdx = grid[y][x].bgEventID & 0x7FFF;
@@ -226,6 +343,15 @@ class JJ1Level : public Level {
 		unsigned char getEventType(int x, int y) {
 			return getEventElement(x, y)->event;
 		}
+		unsigned char getMaskRow(int tile, int row) {
+			return mask[tile].rows[row];
+		}
+		unsigned char getMaskColumn(int tile, int column) {
+			return maskColumns[tile][column];
+		}
+		unsigned char getMaskType(int tile) {
+			return maskType[tile];
+		}
 
 	protected:
 		Font* font; ///< On-screen message font
@@ -235,21 +361,38 @@ class JJ1Level : public Level {
 		int  load (char* fileName, bool checkpoint);
 		int  step ();
 		void draw ();
+		void findCells (fixed left, fixed top, fixed width, fixed height, int* cellLeft, int* cellTop, int* cellRight, int* cellBottom);
 
 	public:
 		unsigned char * rle_panel=0;
 		JJ1EventPath path[PATHS]; ///< Pre-defined event movement paths
+		ObjectPool   eventPool; ///< Active events
+		ObjectPool   bulletPool; ///< Active bullets
 
 		JJ1Level          (Game* owner, char* fileName, bool checkpoint);
 		virtual ~JJ1Level ();
 
+		static void   prefetch      (char* fileName);
+
 		bool          checkMaskUp   (fixed x, fixed y);
 		bool          checkMaskDown (fixed x, fixed y);
 		bool          checkSpikes   (fixed x, fixed y);
+		int           sweepUp       (fixed x, fixed y, int steps);
+		int           sweepDown     (fixed x, fixed y, int steps);
+		int           sweepLeft     (fixed x, fixed y, int steps);
+		int           sweepRight    (fixed x, fixed y, int steps);
+#ifdef BENCHMARK
+		int           checkSweeps   (int points);
+		unsigned int  getLoadingTime ();
+#endif
 		int           getWorld      ();
 		void          setNext       (int nextLevel, int nextWorld);
 		void          setTile       (unsigned char gridX, unsigned char gridY, unsigned char tile);
-		JJ1Event*     getEvents     ();
+		int           countEvents   ();
+		JJ1Event*     getActiveEvent (int index);
+		int           findEvents    (fixed left, fixed top, fixed width, fixed height, JJ1Event** found);
+		bool          isEventActive (unsigned char gridX, unsigned char gridY);
+		void          setEventActive (unsigned char gridX, unsigned char gridY, bool active);
 		JJ1EventType* getEvent      (unsigned char gridX, unsigned char gridY);
 		unsigned char getEventHits  (unsigned char gridX, unsigned char gridY);
 		unsigned int  getEventTime  (unsigned char gridX, unsigned char gridY);
@@ -273,12 +416,19 @@ class JJ1DemoLevel : public JJ1Level {
 
 	private:
 		unsigned char* macro; ///< Sequence of player control codes
+		int            macroLength; ///< Number of player control codes
+		bool           recorded; ///< Whether there is one control code per step, rather than per 76 ticks
+
+		bool useMacro (int point);
 
 	public:
-		JJ1DemoLevel  (Game* owner, const char* fileName);
+		JJ1DemoLevel  (Game* owner, const char* fileName, bool recordedInput = false);
 		~JJ1DemoLevel ();
 
-		int play   ();
+		int play      ();
+#ifdef BENCHMARK
+		int benchmark (int frames, Benchmark* bench);
+#endif
 
 };
 
@@ -44,6 +44,8 @@
 #include "util.h"
 #include "surface.h"
 
+#include <string.h>
+
 /**
  * Level iteration.
  *
@@ -51,7 +53,8 @@
  */
 int JJ1Level::step () {
 
-	JJ1Event *event;
+	JJ1Event* event;
+	JJ1Bullet* bullet;
 	int viewH;
 	int x, y;
 
@@ -76,43 +79,33 @@ int JJ1Level::step () {
 				(ge->bgEventID & 0x7FFF) && ((gv->event) < 121) &&
 				((eventSet[gv->event]).difficulty <= game->getDifficulty())) {
 
-				event = events;
-
-				while (event) {
-
-					// If the event has been found, stop searching
-					if (event->isFrom(x, y)) break;
-
-					event = event->getNext();
-
-				}
-
-				// If the event wasn't found, create it
-				if (!event) {
+				// If the event isn't already active, create it. If there is
+				// no room, try again next time
+				if (!isEventActive(x, y) && eventPool.hasRoom()) {
 
 					switch (getEvent(x, y)->movement) {
 
 						case 28:
 
-							events = new JJ1Bridge(x, y);
+							new JJ1Bridge(x, y);
 
 							break;
 
 						case 41:
 
-							events = new MedGuardian(x, y);
+							new MedGuardian(x, y);
 
 							break;
 
 						case 60:
 
-							events = new DeckGuardian(x, y);
+							new DeckGuardian(x, y);
 
 							break;
 
 						default:
 
-							events = new JJ1StandardEvent(eventSet + gv->event, x, y, TTOF(x), TTOF(y + 1));
+							new JJ1StandardEvent(eventSet + gv->event, x, y, TTOF(x), TTOF(y + 1));
 
 							break;
 
@@ -127,14 +120,24 @@ int JJ1Level::step () {
 	}
 
 
-	// Process bullets
-	if (bullets) bullets = bullets->step(ticks);
+	// Process bullets, oldest first
+	if (bulletPool.getUsed()) {
+
+		buildBroadPhase();
+
+		bulletPool.startWalk();
+
+		while ((bullet = (JJ1Bullet *)bulletPool.walk())) bullet->step(ticks);
+
+	}
 
 	// Determine the players' trajectories
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->control(ticks);
 
-	// Process active events
-	if (events) events = events->step(ticks);
+	// Process active events, oldest first
+	eventPool.startWalk();
+
+	while ((event = (JJ1Event *)eventPool.walk())) event->step(ticks);
 
 	// Apply as much of those trajectories as possible, without going into the
 	// scenery
@@ -204,17 +207,214 @@ int JJ1Level::step () {
 
 
 
+#ifdef SCROLL_LAYER
+/// Background layer, kept between frames
+static unsigned char layerPixels[canvasW * canvasH];
+
+
+/**
+ * Move the contents of the background layer to follow the viewport.
+ *
+ * @param dx Horizontal distance moved by the viewport
+ * @param dy Vertical distance moved by the viewport
+ * @param viewH Height of the visible part of the level
+ */
+void JJ1Level::scrollLayer (int dx, int dy, int viewH) {
+
+	unsigned char* dst;
+	unsigned char* src;
+	int width, y;
+
+	dst = layer.pix + ((dx < 0)? -dx: 0);
+	src = layer.pix + ((dx > 0)? dx: 0) + (dy * canvasW);
+	width = canvasW - ((dx < 0)? -dx: dx);
+
+	// Work away from the rows being read, so none are overwritten before use
+	if (dy >= 0) {
+
+		for (y = 0; y < viewH - dy; y++)
+			memmove(dst + (y * canvasW), src + (y * canvasW), width);
+
+	} else {
+
+		for (y = viewH - 1; y >= -dy; y--)
+			memmove(dst + (y * canvasW), src + (y * canvasW), width);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Move the keys of the drawn grid cells to follow the viewport.
+ *
+ * @param dx Number of tiles moved horizontally by the viewport
+ * @param dy Number of tiles moved vertically by the viewport
+ */
+void JJ1Level::shiftTileKeys (int dx, int dy) {
+
+	unsigned int old[DAMAGE_H][DAMAGE_W];
+	int x, y;
+
+	if (!dx && !dy) return;
+
+	memcpy(old, drawnTiles, sizeof(old));
+
+	for (y = 0; y < DAMAGE_H; y++) {
+
+		for (x = 0; x < DAMAGE_W; x++) {
+
+			if ((x + dx >= 0) && (x + dx < DAMAGE_W) && (y + dy >= 0) && (y + dy < DAMAGE_H))
+				drawnTiles[y][x] = old[y + dy][x + dx];
+			else
+				drawnTiles[y][x] = 0xFFFFFFFE; // Not a valid key
+
+		}
+
+	}
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Draw a tile, copying solid rows straight and skipping empty ones.
+ *
+ * @param tile The index of the tile to draw
+ * @param x The x-coordinate at which to draw the tile
+ * @param y The y-coordinate at which to draw the tile
+ */
+void JJ1Level::drawTile (int tile, int x, int y) {
+
+	short src[4];
+	unsigned int opaque, clear, run;
+	int row, end;
+
+	src[0] = 0;
+	src[1] = TTOI(tile);
+	src[2] = TTOI(1);
+	src[3] = TTOI(1);
+
+	if ((tile < 0) || (tile >= 240)) {
+
+		blitPartToCanvas(&tileSet, x, y, src);
+
+		return;
+
+	}
+
+	opaque = tileOpaque[tile];
+	clear = tileClear[tile];
+
+	if (clear == 0xFFFFFFFF) return;
+
+	if (opaque == 0xFFFFFFFF) {
+
+		blitPartToCanvas(&solidTileSet, x, y, src);
+
+		return;
+
+	}
+
+	// Draw the tile in bands of rows of the same kind
+	for (row = 0; row < 32; row = end) {
+
+		run = (opaque >> row) & 1? opaque: ((clear >> row) & 1? clear: ~(opaque | clear));
+
+		for (end = row + 1; (end < 32) && ((run >> end) & 1); end++);
+
+		if ((clear >> row) & 1) continue;
+
+		src[1] = TTOI(tile) + row;
+		src[3] = end - row;
+		blitPartToCanvas(((opaque >> row) & 1)? &solidTileSet: &tileSet, x, y + row, src);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw the background of a grid cell.
+ *
+ * @param x The x-coordinate of the cell, in tiles from the left of the view
+ * @param y The y-coordinate of the cell, in tiles from the top of the view
+ * @param vX The x-coordinate of the viewport
+ * @param vY The y-coordinate of the viewport
+ * @param fill Colour to clear the cell to first, or -1 to draw over it
+ */
+void JJ1Level::drawBackgroundTile (int x, int y, int vX, int vY, int fill) {
+
+	GridElement *ge;
+	int dstX, dstY;
+	unsigned char ev;
+
+	dstX = TTOI(x) - (vX & 31);
+	dstY = TTOI(y) - (vY & 31);
+
+	if ((x + ITOT(vX) >= 256) || (y + ITOT(vY) >= 64)) {
+
+		drawRect(dstX, dstY, 32, 32, LEVEL_BLACK);
+
+		return;
+
+	}
+
+	// Get the grid element from the given coordinates
+	ge = grid[y + ITOT(vY)] + x + ITOT(vX);
+	ev = eventElms[ge->bgEventID & 0x7FFF].event;
+
+	// If this tile uses a black background, draw it
+	if (ge->bgEventID & (1 << 15))
+		drawRect(dstX, dstY, 32, 32, LEVEL_BLACK);
+	else if (fill >= 0)
+		drawRect(dstX, dstY, 32, 32, fill);
+
+
+	// If this is not a foreground tile, draw it
+	if ((ev != 124) &&
+		(ev != 125) &&
+		(eventSet[ev].movement != 37) &&
+		(eventSet[ev].movement != 38)) {
+
+		drawTile(ge->tile, dstX, dstY);
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Draw the level.
  */
 void JJ1Level::draw () {
 
 	GridElement *ge;
+	JJ1Event* event;
+	JJ1Bullet* bullet;
 	//SDL_Rect dst;
 	short src[4];//x y w h
+	short part[4];
+	unsigned short dirty[DAMAGE_H];
+#ifdef SCROLL_LAYER
+	unsigned short stale[DAMAGE_H];
+	unsigned char* pixels;
+#endif
+	unsigned int key;
+	unsigned char ev;
 	int viewH;
 	int vX, vY;
 	int x, y, bgScale;
+	int dstX, dstY, orbX, orbY, left, top;
+	bool full;
 	unsigned int change;
 
 	// Calculate change since last step
@@ -250,12 +450,142 @@ void JJ1Level::draw () {
 	src[0] = 0;
 
 
-	// If there is a sky, draw it
-	if (sky) {
+	// Find the grid cells that need redrawing: those whose contents have
+	// changed, and those that have been drawn over since the last frame.
+	// If the viewport has moved, everything needs redrawing.
+
+	stopDamage();
+
+	full = (vX != drawnX) || (vY != drawnY);
+
+#ifdef SCROLL_LAYER
+	// Move the background layer with the viewport, so only the newly exposed
+	// strips need drawing into it
+	if (!full) {
+
+		memset(stale, 0, sizeof(stale));
+
+	} else if ((drawnX < 0) || (vX - drawnX >= canvasW) || (drawnX - vX >= canvasW) ||
+		(vY - drawnY >= viewH) || (drawnY - vY >= viewH)) {
+
+		initMiniSurface(&layer, layerPixels, canvasW, canvasH);
+		if (sky) setColKey(&layer, TKEY);
+
+		memset(stale, 0xFF, sizeof(stale));
+
+	} else {
+
+		scrollLayer(vX - drawnX, vY - drawnY, viewH);
+
+		// Keep the keys of the grid cells which are still visible
+		shiftTileKeys(ITOT(vX) - ITOT(drawnX), ITOT(vY) - ITOT(drawnY));
+
+		memset(stale, 0, sizeof(stale));
+
+		// Newly exposed columns
+		if (vX > drawnX) {
+
+			for (x = (canvasW - (vX - drawnX) + (vX & 31)) >> 5; x < DAMAGE_W; x++)
+				for (y = 0; y < DAMAGE_H; y++) stale[y] |= 1 << x;
+
+		} else if (vX < drawnX) {
+
+			for (x = (drawnX - vX - 1 + (vX & 31)) >> 5; x >= 0; x--)
+				for (y = 0; y < DAMAGE_H; y++) stale[y] |= 1 << x;
+
+		}
 
-		// Background scale
-		if (canvasW > 320) bgScale = ((canvasH - 1) / 100) + 1;
-		else bgScale = ((canvasH - 34) / 100) + 1;
+		// Newly exposed rows
+		if (vY > drawnY) {
+
+			for (y = (viewH - (vY - drawnY) + (vY & 31)) >> 5; y < DAMAGE_H; y++)
+				stale[y] = (1 << DAMAGE_W) - 1;
+
+		} else if (vY < drawnY) {
+
+			for (y = (drawnY - vY - 1 + (vY & 31)) >> 5; y >= 0; y--)
+				stale[y] = (1 << DAMAGE_W) - 1;
+
+		}
+
+	}
+#endif
+
+	drawnX = vX;
+	drawnY = vY;
+
+	for (y = 0; y < DAMAGE_H; y++) {
+
+		dirty[y] = full? (1 << DAMAGE_W) - 1: canvasDamage[y];
+		canvasDamage[y] = 0;
+
+		for (x = 0; x < DAMAGE_W; x++) {
+
+			if ((x + ITOT(vX) >= 256) || (y + ITOT(vY) >= 64)) {
+
+				key = 0xFFFFFFFF;
+
+			} else {
+
+				ge = grid[y + ITOT(vY)] + x + ITOT(vX);
+				ev = eventElms[ge->bgEventID & 0x7FFF].event;
+
+				key = ge->tile | (ev << 8) | ((ge->bgEventID & (1 << 15)) << 1);
+
+				// Animated foreground tiles change with time
+				if (ev == 123) key |= (ticks & 64) << 17;
+
+			}
+
+			if (key != drawnTiles[y][x]) {
+
+				drawnTiles[y][x] = key;
+				dirty[y] |= 1 << x;
+#ifdef SCROLL_LAYER
+				stale[y] |= 1 << x;
+#endif
+
+			}
+
+		}
+
+	}
+
+
+#ifdef SCROLL_LAYER
+	// Bring the background layer up to date, by temporarily drawing into it
+	// instead of the canvas
+
+	pixels = canvas.pix;
+	canvas.pix = layer.pix;
+
+	for (y = 0; y < DAMAGE_H; y++) {
+
+		if (!stale[y]) continue;
+
+		for (x = 0; x < DAMAGE_W; x++) {
+
+			if (stale[y] & (1 << x)) drawBackgroundTile(x, y, vX, vY, TKEY);
+
+		}
+
+	}
+
+	canvas.pix = pixels;
+#endif
+
+
+	// Background scale
+	if (canvasW > 320) bgScale = ((canvasH - 1) / 100) + 1;
+	else bgScale = ((canvasH - 34) / 100) + 1;
+
+	// Position of the sun / moon / etc.
+	orbX = ((canvasW * 4) / 5) - (vX & 3);
+	orbY = ((canvasH - 33) * 3) / 25;
+
+
+	// If there is a sky, draw it
+	if (full && sky) {
 
 		for (y = 0; y < viewH; y += bgScale)
 			drawRect(0, y, canvasW, bgScale, 156 + (y / bgScale));
@@ -265,10 +595,10 @@ void JJ1Level::draw () {
 		if (skyOrb) {
 
 			src[1] = TTOI(skyOrb);
-			blitPartToCanvas(&tileSet,((canvasW * 4) / 5) - (vX & 3),((canvasH - 33) * 3) / 25,src);
+			blitPartToCanvas(&tileSet, orbX, orbY, src);
 		}
 
-	} else {
+	} else if (full) {
 
 		// If there is no sky, draw a blank background
 		// This is only very occasionally actually visible
@@ -277,6 +607,11 @@ void JJ1Level::draw () {
 	}
 
 
+#ifdef SCROLL_LAYER
+	// Show the whole background layer
+	if (full) blitToCanvas(&layer, 0, 0);
+#endif
+
 
 	// Show background tiles
 
@@ -284,76 +619,108 @@ void JJ1Level::draw () {
 
 		for (x = 0; x <= ITOT(canvasW - 1) + 1; x++) {
 
-			if ((x + ITOT(vX) >= 256) || (y + ITOT(vY) >= 64)) {
+#ifdef SCROLL_LAYER
+			if (full || !(dirty[y] & (1 << x))) continue;
+#else
+			if (!(dirty[y] & (1 << x))) continue;
+#endif
 
-				drawRect(TTOI(x) - (vX & 31), TTOI(y) - (vY & 31), 32, 32, LEVEL_BLACK);
+			dstX = TTOI(x) - (vX & 31);
+			dstY = TTOI(y) - (vY & 31);
 
-				continue;
+			if (!full) {
 
-			}
+				// Redraw the part of the sky behind this tile
+				if (sky) {
 
-			// Get the grid element from the given coordinates
-			ge = grid[y + ITOT(vY)] + x + ITOT(vX);
-			GridEventElement* gv = &eventElms[ge->bgEventID & 0x7FFF];
-			unsigned char ev = gv->event;
+					for (top = (dstY < 0)? 0: dstY; (top < dstY + 32) && (top < viewH); top++)
+						drawRect(dstX, top, 32, 1, 156 + (top / bgScale));
 
-			// If this tile uses a black background, draw it
-			if (ge->bgEventID & (1 << 15))
-				drawRect(TTOI(x) - (vX & 31), TTOI(y) - (vY & 31), 32, 32, LEVEL_BLACK);
+					if (skyOrb && (dstX < orbX + 32) && (orbX < dstX + 32) &&
+						(dstY < orbY + 32) && (orbY < dstY + 32)) {
 
+						left = (dstX > orbX)? dstX: orbX;
+						top = (dstY > orbY)? dstY: orbY;
 
-			// If this is not a foreground tile, draw it
-			if ((ev != 124) &&
-				(ev != 125) &&
-				(eventSet[ev].movement != 37) &&
-				(eventSet[ev].movement != 38)) {
+						part[0] = left - orbX;
+						part[1] = TTOI(skyOrb) + top - orbY;
+						part[2] = ((dstX < orbX)? dstX: orbX) + 32 - left;
+						part[3] = ((dstY < orbY)? dstY: orbY) + 32 - top;
+						blitPartToCanvas(&tileSet, left, top, part);
+
+					}
+
+				} else drawRect(dstX, dstY, 32, 32, 127);
 
-				//dst.x = TTOI(x) - (vX & 31);
-				//dst.y = TTOI(y) - (vY & 31);
-				src[1] = TTOI(ge->tile);
-				//SDL_BlitSurface(tileSet, &src, canvas, &dst);
-				blitPartToCanvas(&tileSet,TTOI(x) - (vX & 31),TTOI(y) - (vY & 31),src);
 			}
 
+#ifdef SCROLL_LAYER
+			// Copy the tile from the background layer
+			left = (dstX < 0)? 0: dstX;
+			top = (dstY < 0)? 0: dstY;
+
+			part[0] = left;
+			part[1] = top;
+			part[2] = dstX + TTOI(1) - left;
+			part[3] = dstY + TTOI(1) - top;
+			blitPartToCanvas(&layer, left, top, part);
+#else
+			drawBackgroundTile(x, y, vX, vY, -1);
+#endif
+
 		}
 
 	}
 
 
-	// Show active events
-	if (events) events->draw(ticks, change);
+	// Record where sprites are drawn, so the tiles beneath them can be
+	// restored next frame
+	startDamage(vX & 31, vY & 31);
+
+
+	// Show active events, oldest first
+	eventPool.startWalk();
+
+	while ((event = (JJ1Event *)eventPool.walk())) event->draw(ticks, change);
 
 
 	// Show the players
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->draw(ticks, change);
 
 
-	// Show bullets
-	if (bullets) bullets->draw(change);
+	// Show bullets, oldest first
+	bulletPool.startWalk();
+
+	while ((bullet = (JJ1Bullet *)bulletPool.walk())) bullet->draw(change);
+
+
+	stopDamage();
 
 
 
 	// Show foreground tiles
+	// Only those which have been redrawn or drawn over need to be shown again
 
 	for (y = 0; y <= ITOT(viewH - 1) + 1; y++) {
 
 		for (x = 0; x <= ITOT(canvasW - 1) + 1; x++) {
 
+			if (!((dirty[y] | canvasDamage[y]) & (1 << x))) continue;
+
 			if ((x + ITOT(vX) >= 256) || (y + ITOT(vY) >= 64)) continue;
 
 			// Get the grid element from the given coordinates
 			ge = grid[y + ITOT(vY)] + x + ITOT(vX);
-			unsigned char ev = eventElms[ge->bgEventID & 0x7FFF].event;
+			ev = eventElms[ge->bgEventID & 0x7FFF].event;
 
 			// If this is an "animated" foreground tile, draw it
 			if (ev == 123) {
 
 				//dst.x = TTOI(x) - (vX & 31);
 				//dst.y = TTOI(y) - (vY & 31);
-				if (ticks & 64) src[1] = TTOI(eventSet[ev].multiB);
-				else src[1] = TTOI(eventSet[ev].multiA);
 				//SDL_BlitSurface(tileSet, &src, canvas, &dst);
-				blitPartToCanvas(&tileSet,TTOI(x) - (vX & 31),TTOI(y) - (vY & 31),src);
+				drawTile((ticks & 64)? eventSet[ev].multiB: eventSet[ev].multiA,
+					TTOI(x) - (vX & 31), TTOI(y) - (vY & 31));
 			}
 
 			// If this is a foreground tile, draw it
@@ -364,28 +731,37 @@ void JJ1Level::draw () {
 
 				//dst.x = TTOI(x) - (vX & 31);
 				//dst.y = TTOI(y) - (vY & 31);
-				src[1] = TTOI(ge->tile);
 				//SDL_BlitSurface(tileSet, &src, canvas, &dst);
-				blitPartToCanvas(&tileSet,TTOI(x) - (vX & 31),TTOI(y) - (vY & 31),src);
+				drawTile(ge->tile, TTOI(x) - (vX & 31), TTOI(y) - (vY & 31));
 			}
 
 		}
 
 	}
 
+
+	startDamage(vX & 31, vY & 31);
+
 	// Temporary lines showing the water level
 	drawRect(0, FTOI(waterLevel - viewY), canvasW, 2, 24);
 	drawRect(0, FTOI(waterLevel - viewY) + 3, canvasW, 1, 24);
 	drawRect(0, FTOI(waterLevel - viewY) + 6, canvasW, 1, 24);
 	drawRect(0, FTOI(waterLevel - viewY) + 10, canvasW, 1, 24);
 
-	// Show active guardian's energy bar
-	if (events) events->drawEnergy(ticks);
+	// Show the newest guardian's energy bar
+	for (x = eventPool.getUsed() - 1; x >= 0; x--) {
+
+		if (getActiveEvent(x)->drawEnergy(ticks)) break;
+
+	}
 
 
 	// If this is a competitive game, draw the score
 
 	// Show panel
+	// The panel is redrawn every frame, so it never leaves damage behind
+
+	stopDamage();
 
 	blitToCanvas(&panel,0,canvasH-33);
 
@@ -492,6 +868,10 @@ void JJ1Level::draw () {
 	drawRect(dstx, canvasH - 13, dstw, 7, LEVEL_BLACK);
 
 
+	// Anything drawn over the level from now on must be removed next frame
+	startDamage(vX & 31, vY & 31);
+
+
 	return;
 
 }
@@ -47,6 +47,9 @@
 #include "util.h"
 #include "MAINCHAR.h"
 #include <string.h>
+#ifdef BENCHMARK
+	#include "benchmark.h"
+#endif
 #ifdef CASIO
 	#include <fxcg/keyboard.h>
 	#include <fxcg/display.h>
@@ -59,6 +62,282 @@
 
 #define SKEY 254 /* Sprite colour key */
 
+/* A level cache (.OJC) file holds the decoded contents of a level file and
+its tile set in the order they are loaded, so that the level can be loaded
+with one read and no decoding. The values are stored byte by byte, so the
+same cache works on either byte order. */
+#define CACHE_MAGIC   "OJC"
+#define CACHE_VERSION 2
+#define CACHE_CHUNK   256 /* Bytes of a file checked at a time */
+
+// Caches are made as levels are loaded on the desktop
+#ifndef CASIO
+	#define LEVEL_CACHE_WRITE
+#endif
+
+#ifdef LEVEL_CACHE_WRITE
+static unsigned char* cacheData = NULL; ///< Level data recorded for the cache
+static int cacheLength = 0; ///< Number of bytes recorded
+static int cacheSize = 0; ///< Space available for recording
+static bool cacheFailed = false; ///< Whether or not recording ran out of memory
+#endif
+static unsigned int tilesStamp; ///< Check value of the last tile set loaded
+
+
+/**
+ * Record a block of loaded data for the level cache. If there is not enough
+ * memory, recording stops and no cache is written for the level.
+ *
+ * @param data The data
+ * @param length Number of bytes
+ */
+static void cacheBytes (const void* data, int length) {
+
+#ifdef LEVEL_CACHE_WRITE
+	unsigned char* grown;
+
+	if (cacheFailed) return;
+
+	if (cacheLength + length > cacheSize) {
+
+		grown = (unsigned char *)realloc(cacheData, (cacheLength + length) << 1);
+
+		if (!grown) {
+
+			free(cacheData);
+			cacheData = NULL;
+			cacheSize = 0;
+			cacheFailed = true;
+
+			return;
+
+		}
+
+		cacheData = grown;
+		cacheSize = (cacheLength + length) << 1;
+
+	}
+
+	memcpy(cacheData + cacheLength, data, length);
+	cacheLength += length;
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Record a value for the level cache, in the byte order of the level file.
+ *
+ * @param value The value
+ * @param length Number of bytes to use
+ */
+static void cacheValue (int value, int length) {
+
+	unsigned char bytes[4];
+	int count;
+
+	for (count = 0; count < length; count++) bytes[count] = value >> (count << 3);
+
+	cacheBytes(bytes, length);
+
+	return;
+
+}
+
+
+/**
+ * Record a string for the level cache, in the format read by
+ * File::loadString().
+ *
+ * @param string The string
+ */
+static void cacheString (const char* string) {
+
+	cacheValue(strlen(string), 1);
+	cacheBytes(string, strlen(string));
+
+	return;
+
+}
+
+
+/**
+ * Work out a value which changes if the contents of a file do, from its size
+ * and every byte of it.
+ *
+ * @param file The file
+ *
+ * @return The check value
+ */
+static unsigned int fileStamp (File* file) {
+
+	unsigned char chunk[CACHE_CHUNK];
+	unsigned int stamp;
+	int pos, size, done, length, count;
+
+	pos = file->tell();
+	size = file->getSize();
+
+	file->seek(0, true);
+
+	// FNV-1a
+	stamp = 2166136261u ^ size;
+
+	for (done = 0; done < size; done += length) {
+
+		length = (size - done < CACHE_CHUNK) ? size - done: CACHE_CHUNK;
+
+		file->loadBlock(length, chunk);
+
+		for (count = 0; count < length; count++) {
+
+			stamp ^= chunk[count];
+			stamp *= 16777619;
+
+		}
+
+	}
+
+	file->seek(pos, true);
+
+	return stamp;
+
+}
+
+
+/**
+ * Create the name of the cache file for a level file.
+ *
+ * @param fileName Name of the level file
+ *
+ * @return The new string
+ */
+static char* createCacheName (const char* fileName) {
+
+	char* cacheName;
+	int count;
+
+	cacheName = createString(fileName, ".OJC");
+
+	// LEVEL0.000 becomes LEVEL0_000.OJC
+	for (count = 0; fileName[count]; count++) {
+
+		if (cacheName[count] == '.') cacheName[count] = '_';
+
+	}
+
+	return cacheName;
+
+}
+
+
+/**
+ * Skip past all level data, to the level and world numbers.
+ *
+ * @param file The level file
+ */
+static void seekLevelNumbers (File* file) {
+
+	file->seek(39, true);
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->seek(598, false);
+	file->skipRLE();
+	file->seek(4, false);
+	file->skipRLE();
+	file->skipRLE();
+	file->seek(25, false);
+	file->skipRLE();
+	file->seek(3, false);
+
+	return;
+
+}
+
+
+/**
+ * Create the name of a level's tile set file. The level file must be just
+ * past the level and world numbers.
+ *
+ * @param file The level file
+ * @param world The world number
+ *
+ * @return The new string
+ */
+static char* createTileFileName (File* file, int world) {
+
+	char* ext;
+	char* fileName;
+
+	// Load tile set extension
+	file->seek(8, false);
+	ext = file->loadString();
+
+	// Create tile set file name
+	if (!strcmp(ext, "999")) fileName = createFileName(F_BLOCKS, world);
+	else fileName = createFileName(F_BLOCKS, ext);
+
+	delete[] ext;
+
+	return fileName;
+
+}
+
+
+/**
+ * Queue the sprite and tile set files of a level which has been prefetched.
+ *
+ * @param file The level file
+ */
+static void prefetchLevelFiles (File* file) {
+
+	char* fileName;
+	int world;
+
+	seekLevelNumbers(file);
+	file->loadChar();
+	world = file->loadChar() ^ 4;
+
+	fileName = createFileName(F_SPRITES, world);
+	prefetchFile(fileName);
+	delete[] fileName;
+
+	fileName = createTileFileName(file, world);
+	prefetchFile(fileName);
+	delete[] fileName;
+
+	return;
+
+}
+
+
+/**
+ * Start reading a level's files ahead of it being loaded.
+ *
+ * @param fileName Name of the file containing the level data
+ */
+void JJ1Level::prefetch (char* fileName) {
+
+	char* cacheName;
+
+	prefetchFile(fileName, prefetchLevelFiles);
+
+	cacheName = createCacheName(fileName);
+	prefetchFile(cacheName);
+	delete[] cacheName;
+
+	return;
+
+}
+
 
 /**
  * Load the HUD graphical data.
@@ -71,6 +350,7 @@ int JJ1Level::loadPanel () {
 	File* file;
 	//unsigned char* pixels;
 	unsigned char* sorted;
+	unsigned char window[64 * 32];
 	int type, x, y;
 
 
@@ -83,7 +363,7 @@ int JJ1Level::loadPanel () {
 		return e;
 
 	}
-	rle_panel=(unsigned char*)malloc(46272);
+	rle_panel=(unsigned char*)malloc(SW*32);
 	if(!rle_panel){
 		#ifdef CASIO
 			casioQuitM("rle_panel");
@@ -91,8 +371,12 @@ int JJ1Level::loadPanel () {
 			puts("Malloc rle_panel");
 		#endif
 	}
-	file->loadRLE(46272,rle_panel);
-	delete file;
+
+	// Only the panel background and the ammo graphics are used, so the rest
+	// of the block is decoded without being kept
+	RLEDecoder decoder(file);
+
+	decoder.decode(rle_panel, SW * 32);
 
 
 	// Create the panel background
@@ -100,13 +384,17 @@ int JJ1Level::loadPanel () {
 
 	// De-scramble the panel's ammo graphics
 
+	decoder.skip((55 * 320) - (SW * 32));
+
 	for (type = 0; type < 6; type++) {
 		sorted=(unsigned char *)ammobuf + (64 * 26 * type);
 
+		decoder.decode(window, 64 * 32);
+
 		for (y = 0; y < 26; y++) {
 
 			for (x = 0; x < 64; x++)
-				sorted[(y * 64) + x] = rle_panel[(type * 64 * 32) + (y * 64) + (x >> 2) + ((x & 3) << 4) + (55 * 320)];
+				sorted[(y * 64) + x] = window[(y * 64) + (x >> 2) + ((x & 3) << 4)];
 
 		}
 
@@ -114,10 +402,8 @@ int JJ1Level::loadPanel () {
 
 	}
 
+	delete file;
 
-	rle_panel=(unsigned char*)realloc(rle_panel,SW*32);
-	panel.pix=rle_panel;
-	
 	return E_NONE;
 }
 
@@ -309,6 +595,42 @@ try{
 	//delete specFile;
 	// Include a blank sprite at the end
 	spriteSet[sprites].clearPixels();
+
+	// Sprites from mainchar.000 live in a table, so their spans share a
+	// single object
+	{
+		int spansSize = 0;
+
+		for (count = 0; count < sprites; count++) {
+
+			if (spriteSet[count].pixelsid == INVALID_OBJ)
+				spansSize += spriteSet[count].getSpansSize();
+
+		}
+
+		if (spansSize) {
+
+			addobj(spansSize, &spanSetId);
+			buffer = (unsigned char *)objs[spanSetId].ptr;
+
+			for (count = 0; count < sprites; count++) {
+
+				if (spriteSet[count].pixelsid != INVALID_OBJ) continue;
+
+				spansSize = spriteSet[count].getSpansSize();
+
+				if (spansSize) {
+
+					spriteSet[count].setSpans(buffer);
+					buffer += spansSize;
+
+				}
+
+			}
+
+		}
+
+	}
 }catch (int e){
 	#ifdef CASIO
 		casioQuit("Error loading sprites");
@@ -321,6 +643,88 @@ try{
 }
 
 
+/**
+ * Find which rows of each tile are fully opaque or fully transparent.
+ *
+ * @param tiles The number of tiles loaded
+ */
+void JJ1Level::classifyTiles (int tiles) {
+
+	unsigned char* row;
+	int tile, x, y, keyed;
+
+	for (tile = 0; tile < 240; tile++) {
+
+		tileOpaque[tile] = 0;
+		tileClear[tile] = 0;
+
+		// Tiles which were not loaded are drawn as they always were
+		if (tile >= tiles) continue;
+
+		row = tileSet.pix + (tile << 10);
+
+		for (y = 0; y < 32; y++) {
+
+			keyed = 0;
+
+			for (x = 0; x < 32; x++) {
+
+				if (row[x] == TKEY) keyed++;
+
+			}
+
+			if (!keyed) tileOpaque[tile] |= 1u << y;
+			else if (keyed == 32) tileClear[tile] |= 1u << y;
+
+			row += 32;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+#ifdef CASIO
+#define uintptr_t unsigned
+#endif
+/**
+ * Set up the tile set once its pixels are in place.
+ *
+ * @param tiles The number of tiles loaded
+ */
+void JJ1Level::useTiles (int tiles) {
+
+	unsigned char* buffer;
+	unsigned int tileBytes;
+
+	buffer = (unsigned char *)objs[tileSetramid].ptr;
+
+	//tileSet = createSurface(buffer, TTOI(1), TTOI(tiles));
+	initMiniSurface(&tileSet,buffer, TTOI(1), TTOI(tiles));
+	//SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, TKEY);
+	setColKey(&tileSet,TKEY);
+	initMiniSurface(&solidTileSet,buffer, TTOI(1), TTOI(tiles));
+	classifyTiles(tiles);
+	//delete[] buffer;
+#ifndef CASIO
+	printf("Loaded %d tiles.\n", tiles);
+#endif
+	tileBytes = TTOI(1)*TTOI(tiles);
+	if (tileBytes < sizeof(JJ1BonusLevel) + sizeof(uintptr_t))
+		tileBytes = sizeof(JJ1BonusLevel) + sizeof(uintptr_t);
+	resizeobj(tileSetramid, tileBytes);
+
+	// The tile set object may have moved
+	tileSet.pix = solidTileSet.pix = (unsigned char *)objs[tileSetramid].ptr;
+
+	return;
+
+}
+
+
 /**
  * Load the tileset.
  *
@@ -328,22 +732,26 @@ try{
  *
  * @return The number of tiles loaded
  */
-#ifdef CASIO
-#define uintptr_t unsigned
-#endif
 int JJ1Level::loadTiles(char* fileName) {
 try{
 	unsigned char* buffer;
-	int rle, pos, index, count, fileSize;
+	int rle, pos, index, fileSize;
 	int tiles;
+	unsigned char rgb[768];
 	File file(fileName, false);
 
+	tilesStamp = fileStamp(&file);
+
 	// Load the palette
-	file.loadPalette(palette);
+	file.loadPalette6(rgb);
+	file.convertPalette(palette, rgb);
 	video.setPalette(palette);
+	cacheBytes(rgb, 768);
 
 	// Load the background palette
-	file.loadPalette(skyPalette);
+	file.loadPalette6(rgb);
+	file.convertPalette(skyPalette, rgb);
+	cacheBytes(rgb, 768);
 
 
 	// Skip the second, identical, background palette
@@ -383,16 +791,14 @@ try{
 
 			index = file.loadChar();
 
-			for (count = 0; count < (rle & 127); count++) buffer[pos++] = index;
+			memset(buffer + pos, index, rle & 127);
+			pos += rle & 127;
 
 		} else if (rle) {
-			#ifdef CASIO
-				Bfile_ReadFile_OS(file.file,&buffer[pos],rle,-1);
-				pos+=rle;
-			#else
-				for (count = 0; count < rle; count++)
-					buffer[pos++] = file.loadChar();
-			#endif
+
+			file.loadBlock(rle, buffer + pos);
+			pos += rle;
+
 		} else { // This happens at the end of each tile
 
 			// 0 pixels means 1 pixel, apparently
@@ -414,18 +820,9 @@ try{
 	// Work out how many tiles were actually loaded
 	// Should be a multiple of 60
 	tiles = pos >> 10;
-	//tileSet = createSurface(buffer, TTOI(1), TTOI(tiles));
-	initMiniSurface(&tileSet,buffer, TTOI(1), TTOI(tiles));
-	//SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, TKEY);
-	setColKey(&tileSet,TKEY);
-	//delete[] buffer;
-#ifndef CASIO
-	printf("Loaded %d tiles.\n", tiles);
-#endif
-	unsigned tileBytes = TTOI(1)*TTOI(tiles);
-	if (tileBytes < sizeof(JJ1BonusLevel) + sizeof(uintptr_t))
-		tileBytes = sizeof(JJ1BonusLevel) + sizeof(uintptr_t);
-	resizeobj(tileSetramid, tileBytes);
+	cacheValue(tiles, 2);
+	cacheBytes(buffer, tiles << 10);
+	useTiles(tiles);
 	return tiles;
 }catch(int e){
 	#ifdef CASIO
@@ -436,6 +833,533 @@ try{
 }
 
 
+/**
+ * Create the level grid and the background event elements.
+ *
+ * @param buffer Tile and event references, two bytes per grid element
+ */
+void JJ1Level::createGrid (unsigned char* buffer) {
+
+	unsigned eventID = 0;
+	int x, y;
+
+	addobj(sizeof(GridEventElement), &eventInfoId);
+	eventElms = (GridEventElement* )objs[eventInfoId].ptr;
+	memset(eventElms, 0, sizeof(GridEventElement));
+	for (x = 0; x < LW;++x){
+
+		for (y = 0; y < LH;++y) {
+
+			grid[y][x].tile = buffer[(y + (x * LH)) << 1];
+			unsigned char bgEvent = buffer[((y + (x * LH)) << 1) + 1];
+			if (bgEvent & 127) {
+				++eventID;
+				resizeobj(eventInfoId, sizeof(GridEventElement) * (eventID + 1));
+				eventElms = (GridEventElement* )objs[eventInfoId].ptr;
+				eventElms[eventID].event = bgEvent & 127;
+				eventElms[eventID].hits = 0;
+				eventElms[eventID].time = 0;
+				grid[y][x].bgEventID = ((bgEvent >> 7) << 15) | eventID;
+			} else
+				grid[y][x].bgEventID = (bgEvent >> 7) << 15;
+		}
+	}
+#ifndef CASIO
+	printf("Nonzero event count %d.\n", eventID);
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Create the column bit masks and summaries from the tile masks, and clear
+ * the masks of unused tiles.
+ *
+ * @param tiles Number of tiles in the tile set
+ */
+void JJ1Level::createMaskBits (int tiles) {
+
+	int tile, x, y;
+
+	if (tiles < 240) memset(mask + tiles, 0, (240 - tiles) * sizeof(TileMask));
+
+	memset(maskColumns, 0, sizeof(maskColumns));
+
+	for (tile = 0; tile < 240; tile++) {
+
+		for (y = 0; y < 8; y++) {
+
+			for (x = 0; x < 8; x++) {
+
+				if ((mask[tile].rows[y] >> x) & 1) maskColumns[tile][x] |= 1 << y;
+
+			}
+
+		}
+
+		if (!mask[tile].all) maskType[tile] = MASK_EMPTY;
+		else if (!~mask[tile].all) maskType[tile] = MASK_SOLID;
+		else maskType[tile] = MASK_MIXED;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Create the special event paths.
+ *
+ * @param buffer Path data, 512 bytes per path
+ */
+void JJ1Level::createPaths (unsigned char* buffer) {
+
+	int type, count;
+
+	for (type = 0; type < PATHS; type++) {
+
+		path[type].length = buffer[type << 9] + (buffer[(type << 9) + 1] << 8);
+		if (path[type].length < 1) path[type].length = 1;
+		path[type].x = new short int[path[type].length];
+		path[type].y = new short int[path[type].length];
+
+		for (count = 0; count < path[type].length; count++) {
+
+			path[type].x[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 3] << 2;
+			path[type].y[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 2];
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Create the event set, and count the enemies and items in the grid.
+ *
+ * @param buffer Event data, ELENGTH bytes per event
+ */
+void JJ1Level::createEventSet (unsigned char* buffer) {
+
+	int count, x, y, type;
+
+	// Fill event set with data
+	for (count = 0; count < EVENTS; count++) {
+
+		eventSet[count].difficulty           = buffer[count * ELENGTH];
+		eventSet[count].reflection           = buffer[(count * ELENGTH) + 2];
+		eventSet[count].movement             = buffer[(count * ELENGTH) + 4];
+		eventSet[count].anims[E_LEFTANIM]    = buffer[(count * ELENGTH) + 5];
+		eventSet[count].anims[E_RIGHTANIM]   = buffer[(count * ELENGTH) + 6];
+		eventSet[count].magnitude            = buffer[(count * ELENGTH) + 8];
+		eventSet[count].strength             = buffer[(count * ELENGTH) + 9];
+		eventSet[count].modifier             = buffer[(count * ELENGTH) + 10];
+		eventSet[count].points               = buffer[(count * ELENGTH) + 11];
+		eventSet[count].bullet               = buffer[(count * ELENGTH) + 12];
+		eventSet[count].bulletPeriod         = buffer[(count * ELENGTH) + 13];
+		eventSet[count].speed                = buffer[(count * ELENGTH) + 15] + 1;
+		eventSet[count].animSpeed            = buffer[(count * ELENGTH) + 17] + 1;
+		eventSet[count].sound                = buffer[(count * ELENGTH) + 21];
+		eventSet[count].multiA               = buffer[(count * ELENGTH) + 22];
+		eventSet[count].multiB               = buffer[(count * ELENGTH) + 23];
+		eventSet[count].pieceSize            = buffer[(count * ELENGTH) + 24];
+		eventSet[count].pieces               = buffer[(count * ELENGTH) + 25];
+		eventSet[count].angle                = buffer[(count * ELENGTH) + 26];
+		eventSet[count].anims[E_LFINISHANIM] = buffer[(count * ELENGTH) + 28];
+		eventSet[count].anims[E_RFINISHANIM] = buffer[(count * ELENGTH) + 29];
+		eventSet[count].anims[E_LSHOOTANIM]  = buffer[(count * ELENGTH) + 30];
+		eventSet[count].anims[E_RSHOOTANIM]  = buffer[(count * ELENGTH) + 31];
+
+	}
+
+	// Process grid
+
+	enemies = items = 0;
+
+	for (x = 0; x < LW; x++) {
+
+		for (y = 0; y < LH; y++) {
+
+			type = getEventType(x, y);
+
+			if (type) {
+
+				// If the event hurts and can be killed, it is an enemy
+				// Anything else that scores is an item
+				if ((eventSet[type].modifier == 0) && eventSet[type].strength) enemies++;
+				else if (eventSet[type].points) items++;
+			}
+		}
+	}
+
+	return;
+
+}
+
+
+/**
+ * Create the animation set. The sprites must already be loaded.
+ *
+ * @param buffer Animation data, 64 bytes per animation
+ */
+void JJ1Level::createAnims (unsigned char* buffer) {
+
+	int count, x, y;
+
+	for (count = 0; count < ANIMS; count++) {
+
+		animSet[count].setData(buffer[(count << 6) + 6],
+			buffer[count << 6], buffer[(count << 6) + 1],
+			buffer[(count << 6) + 3], buffer[(count << 6) + 4],
+			buffer[(count << 6) + 2], buffer[(count << 6) + 5]);
+
+		for (y = 0; y < buffer[(count << 6) + 6]; y++) {
+
+			// Get frame
+			x = buffer[(count << 6) + 7 + y];
+			if (x > sprites) x = sprites;
+			// Assign sprite and vertical offset
+			animSet[count].setFrame(y, true);
+			animSet[count].setFrameData(spriteSet + x,
+				buffer[(count << 6) + 26 + y], buffer[(count << 6) + 45 + y]);
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Create the chain of palette effects.
+ *
+ * @param type The background palette effect type
+ * @param checkpoint Whether or not the player(s) will start at a checkpoint
+ */
+void JJ1Level::createEffects (int type, bool checkpoint) {
+
+	sky = false;
+
+	switch (type) {
+
+		case 2:
+
+			sky = true;
+
+			// Sky background effect
+			paletteEffects = new SkyPaletteEffect(156, 100, FH, skyPalette, NULL);
+
+			break;
+
+		case 8:
+
+			// Parallaxing background effect
+			paletteEffects = new P2DPaletteEffect(128, 64, FE, NULL);
+
+			break;
+
+		case 9:
+
+			// Diagonal stripes "parallaxing" background effect
+			paletteEffects = new P1DPaletteEffect(128, 32, FH, NULL);
+
+			break;
+
+		case 11:
+
+			// The deeper below water, the darker it gets
+			paletteEffects = new WaterPaletteEffect(TTOF(32), NULL);
+
+			break;
+
+		default:
+
+			// No effect
+			paletteEffects = NULL;
+
+			break;
+
+	}
+
+	// Palette animations
+	// These are applied to every level without a conflicting background effect
+	// As a result, there are a few levels with things animated that shouldn't
+	// be
+
+	// In Diamondus: The red/yellow palette animation
+	paletteEffects = new RotatePaletteEffect(112, 4, F32, paletteEffects);
+
+	// In Diamondus: The waterfall palette animation
+	paletteEffects = new RotatePaletteEffect(116, 8, F16, paletteEffects);
+
+	// The following were discoverd by Unknown/Violet
+
+	paletteEffects = new RotatePaletteEffect(124, 3, F16, paletteEffects);
+
+	if ((type != PE_1D) && (type != PE_2D))
+		paletteEffects = new RotatePaletteEffect(132, 8, F16, paletteEffects);
+
+	if ((type != PE_SKY) && (type != PE_2D))
+		paletteEffects = new RotatePaletteEffect(160, 32, -F16, paletteEffects);
+
+	if (type != PE_SKY) {
+
+		paletteEffects = new RotatePaletteEffect(192, 32, -F32, paletteEffects);
+		paletteEffects = new RotatePaletteEffect(224, 16, F16, paletteEffects);
+
+	}
+
+	// Level fade-in/white-in effect
+	if (checkpoint) paletteEffects = new FadeInPaletteEffect(T_START, paletteEffects);
+	else paletteEffects = new WhiteInPaletteEffect(T_START, paletteEffects);
+
+	return;
+
+}
+
+
+/**
+ * Load the level from its cache file, if there is one and it was made from
+ * the current level and tile set files.
+ *
+ * @param fileName Name of the file containing the level data
+ * @param levelStamp Check value of the level file
+ * @param checkpoint Whether or not the player(s) will start at a checkpoint
+ *
+ * @return Whether or not the level was loaded
+ */
+bool JJ1Level::loadCache (char* fileName, unsigned int levelStamp, bool checkpoint) {
+
+	Anim* pAnims[JJ1PANIMS];
+	File* file;
+	File* tileFile;
+	unsigned char header[4];
+	unsigned char* buffer;
+	char* string;
+	char* tileName;
+	int tiles, length, count, x, y;
+	unsigned char startX, startY;
+
+	string = createCacheName(fileName);
+
+	try {
+
+		file = new File(string, false);
+
+	} catch (int e) {
+
+		file = NULL;
+
+	}
+
+	delete[] string;
+
+	if (!file) return false;
+
+	// Check the cache before changing anything
+	file->loadBlock(4, header);
+
+	if (memcmp(header, CACHE_MAGIC, 3) || (header[3] != CACHE_VERSION) ||
+		((unsigned int)file->loadInt() != levelStamp)) {
+
+		delete file;
+
+		return false;
+
+	}
+
+	tileName = file->loadString();
+
+	try {
+
+		tileFile = new File(tileName, false);
+
+	} catch (int e) {
+
+		tileFile = NULL;
+
+	}
+
+	if (tileFile) {
+
+		if ((unsigned int)file->loadInt() != fileStamp(tileFile)) length = -1;
+		else length = file->loadInt();
+
+		delete tileFile;
+
+	} else length = -1;
+
+	if (length != file->getSize() - file->tell()) {
+
+		delete[] tileName;
+		delete file;
+
+		return false;
+
+	}
+
+
+	levelNum = file->loadChar();
+	worldNum = file->loadChar();
+
+	// Sprites are not cached
+	string = createFileName(F_SPRITES, worldNum);
+	#ifdef CASIO
+		drawStrL(2,"Sprites");
+	#endif
+	count = loadSprites(string);
+
+	delete[] string;
+
+	if (count < 0) {
+
+		// Leave the error to the full load
+		delete[] tileName;
+		delete file;
+
+		return false;
+
+	}
+
+	tileFileName = tileName;
+
+	#ifdef CASIO
+		drawStrL(2,"Cache");
+	#endif
+	file->loadPalette(palette, false);
+	video.setPalette(palette);
+	file->loadPalette(skyPalette, false);
+
+	tiles = file->loadShort();
+	addobj(tiles << 10, &tileSetramid);
+	file->loadBlock(tiles << 10, (unsigned char *)objs[tileSetramid].ptr);
+	useTiles(tiles);
+
+	// The grid is the largest block
+	buffer = (unsigned char *)malloc(LW * LH * 2);
+	if(!buffer){
+		#ifdef CASIO
+			casioQuitM("cache");
+		#else
+			puts("Malloc error cache");
+		#endif
+	}
+
+	file->loadBlock(LW * LH * 2, buffer);
+	createGrid(buffer);
+
+	file->loadBlock(tiles * 8, mask[0].rows);
+	createMaskBits(tiles);
+
+	file->loadBlock(PATHS << 9, buffer);
+	createPaths(buffer);
+
+	file->loadBlock(EVENTS * ELENGTH, buffer);
+	createEventSet(buffer);
+
+	file->loadBlock(ANIMS << 6, buffer);
+	createAnims(buffer);
+
+	sceneFile = file->loadString();
+
+	startX = file->loadChar();
+	startY = file->loadChar();
+	x = file->loadChar();
+	y = file->loadChar();
+	setNext(x, y);
+
+	waterLevelTarget = ITOF(file->loadShort() + 17);
+	waterLevel = waterLevelTarget - F8;
+	waterLevelSpeed = -80000;
+
+	file->loadBlock(JJ1PANIMS * 2, buffer);
+
+	for (x = 0; x < JJ1PANIMS; x++) {
+
+		playerAnims[x] = buffer[x << 1];
+		pAnims[x] = animSet + playerAnims[x];
+	}
+
+	free(buffer);
+
+	createLevelPlayers(LT_JJ1, pAnims, NULL, checkpoint, startX, startY);
+
+	file->loadBlock(4, (unsigned char *)miscAnims);
+	file->loadBlock(BULLETS * BLENGTH, (unsigned char *)bulletSet);
+
+	createEffects(file->loadChar(), checkpoint);
+
+	skyOrb = file->loadChar();
+	miscAnims[MA_LBOARD] = file->loadChar();
+	miscAnims[MA_RBOARD] = file->loadChar();
+
+	delete file;
+
+	return true;
+
+}
+
+
+/**
+ * Write the level data recorded while loading to the level's cache file, then
+ * free the recording. Nothing is written if recording ran out of memory.
+ *
+ * @param fileName Name of the file containing the level data
+ * @param levelStamp Check value of the level file
+ */
+void JJ1Level::saveCache (char* fileName, unsigned int levelStamp) {
+
+#ifdef LEVEL_CACHE_WRITE
+	unsigned char* data;
+	char* cacheName;
+	int bodyLength, headerLength;
+
+	// Record the header after the body, then put it in front
+	bodyLength = cacheLength;
+
+	cacheBytes(CACHE_MAGIC, 3);
+	cacheValue(CACHE_VERSION, 1);
+	cacheValue(levelStamp, 4);
+	cacheString(tileFileName);
+	cacheValue(tilesStamp, 4);
+	cacheValue(bodyLength, 4);
+
+	if (!cacheFailed) {
+
+		headerLength = cacheLength - bodyLength;
+
+		data = new unsigned char[cacheLength];
+		memcpy(data, cacheData + bodyLength, headerLength);
+		memcpy(data + headerLength, cacheData, bodyLength);
+
+		cacheName = createCacheName(fileName);
+		saveFile(cacheName, data, cacheLength);
+
+		delete[] cacheName;
+		delete[] data;
+
+	}
+
+	// The recording is not needed until the next level
+	free(cacheData);
+	cacheData = NULL;
+	cacheSize = 0;
+	cacheLength = 0;
+#endif
+
+	return;
+
+}
+
+
 /**
  * Load the level.
  *
@@ -462,6 +1386,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	unsigned char* buffer;
 	const char* ext;
 	char* string = NULL;
+	unsigned int levelStamp;
 	int tiles;
 	int count, x, y, type;
 	unsigned char startX, startY;
@@ -582,7 +1507,28 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	delete[] string;
 
+#ifdef BENCHMARK
+	// Show the loading screen without the frame limiter, which would pad out
+	// fast loads, and keep it out of the time taken to load
+	loadingTime = benchTime();
+	video.flip(0, NULL);
+	loadingTime = benchTime() - loadingTime;
+#else
 	if (::loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
+#endif
+
+	// Set the tick at which the level will end
+	endTime = (5 - game->getDifficulty()) * 2 * 60 * 1000;
+
+	memset(activeEvents, 0, sizeof(activeEvents));
+	eventPool.init(eventSlots, EVENT_SLOT_SIZE, EVENT_SLOTS,
+		eventSpares, EVENT_SPARE_SIZE, EVENT_SPARES, eventOrder);
+	bulletPool.init(bulletSlots, BULLET_SLOT_SIZE, BULLET_SLOTS,
+		bulletSpares, BULLET_SPARE_SIZE, BULLET_SPARES, bulletOrder);
+	energyBar = 0;
+	ammoType = 0;
+	ammoOffset = -1;
+	drawnX = -1;
 
 	// Open level file
 
@@ -599,28 +1545,30 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	}
 
+	levelStamp = fileStamp(file);
+
+	if (loadCache(fileName, levelStamp, checkpoint)) {
+
+		delete file;
+
+		#ifdef CASIO
+			drawStrL(2,"Done");
+		#endif
+		return E_NONE;
+
+	}
+
+	#ifdef LEVEL_CACHE_WRITE
+		// Record the level as it is decoded
+		cacheLength = 0;
+		cacheFailed = false;
+	#endif
+
 	// Load the blocks.### extension
 	#ifdef CASIO
 		drawStrL(2,"Layout");
 	#endif
-	// Skip past all level data
-	file->seek(39, true);
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->seek(598, false);
-	file->skipRLE();
-	file->seek(4, false);
-	file->skipRLE();
-	file->skipRLE();
-	file->seek(25, false);
-	file->skipRLE();
-	file->seek(3, false);
+	seekLevelNumbers(file);
 
 	// Load the level number
 	levelNum = file->loadChar() ^ 210;
@@ -628,6 +1576,9 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	// Load the world number
 	worldNum = file->loadChar() ^ 4;
 
+	cacheValue(levelNum, 1);
+	cacheValue(worldNum, 1);
+
 	// Load sprite set from corresponding Sprites.###
 
 	string = createFileName(F_SPRITES, worldNum);
@@ -654,15 +1605,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	
 	// Load tile set from appropriate blocks.###
 
-	// Load tile set extension
-	file->seek(8, false);
-	ext = file->loadString();
-
-	// Create tile set file name
-	if (!strcmp(ext, "999")) tileFileName = createFileName(F_BLOCKS, worldNum);
-	else tileFileName = createFileName(F_BLOCKS, ext);
-
-	delete[] ext;
+	tileFileName = createTileFileName(file, worldNum);
 	#ifdef CASIO
 		drawStrL(2,"Tiles");
 	#endif
@@ -698,33 +1641,11 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	}
 	file->loadRLE(LW * LH * 2,buffer);
 
-	// Create grid from data
-	unsigned eventID = 0;
-	addobj(sizeof(GridEventElement), &eventInfoId);
-	eventElms = (GridEventElement* )objs[eventInfoId].ptr;
-	memset(eventElms, 0, sizeof(GridEventElement));
-	for (x = 0; x < LW;++x){
-
-		for (y = 0; y < LH;++y) {
-
-			grid[y][x].tile = buffer[(y + (x * LH)) << 1];
-			unsigned char bgEvent = buffer[((y + (x * LH)) << 1) + 1];
-			if (bgEvent & 127) {
-				++eventID;
-				resizeobj(eventInfoId, sizeof(GridEventElement) * (eventID + 1));
-				eventElms[eventID].event = bgEvent & 127;
-				eventElms[eventID].hits = 0;
-				eventElms[eventID].time = 0;
-				grid[y][x].bgEventID = ((bgEvent >> 7) << 15) | eventID;
-			} else
-				grid[y][x].bgEventID = (bgEvent >> 7) << 15;
+	cacheBytes(buffer, LW * LH * 2);
 
-		}
+	// Create grid from data
+	createGrid(buffer);
 
-	}
-#ifndef CASIO
-	printf("Nonzero event count %d.\n", eventID);
-#endif
 	free(buffer);
 	//delete[] buffer;
 
@@ -733,24 +1654,10 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 
 	// Load mask data
-	buffer=(unsigned char *)malloc(tiles*8);
-	file->loadRLE(tiles * 8,buffer);
-	if(!buffer){
-		#ifdef CASIO
-			casioQuitM("mask");
-		#else
-			puts("Malloc error mask");
-		#endif
-	}
-	// Unpack bits
-	for (count = 0; count < tiles; count++) {
-		for (y = 0; y < 8; y++) {
-			for (x = 0; x < 8; x++)
-				mask[count][(y << 3) + x] = (buffer[(count << 3) + y] >> x) & 1;
-		}
-	}
-	//delete[] buffer;
-	free(buffer);
+	// The masks are stored packed, one byte per row, as they are in the file
+	file->loadRLE(tiles * 8, mask[0].rows);
+	cacheBytes(mask, tiles * 8);
+	createMaskBits(tiles);
 	/* Uncomment the code below if you want to see the mask instead of the tile
 	graphics during gameplay */
 
@@ -762,7 +1669,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 			for (x = 0; x < 32; x++) {
 
-				if (mask[count][((y >> 2) << 3) + (x >> 2)] == 1)
+				if ((mask[count].rows[y >> 2] >> (x >> 2)) & 1)
 					((char *)(tileSet->pixels))
 						[(count * 1024) + (y * 32) + x] = 88;
 
@@ -778,22 +1685,9 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	// Load special event path
 	buffer=(unsigned char *)malloc(PATHS << 9);
 	file->loadRLE(PATHS << 9,buffer);
+	cacheBytes(buffer, PATHS << 9);
 
-	for (type = 0; type < PATHS; type++) {
-
-		path[type].length = buffer[type << 9] + (buffer[(type << 9) + 1] << 8);
-		if (path[type].length < 1) path[type].length = 1;
-		path[type].x = new short int[path[type].length];
-		path[type].y = new short int[path[type].length];
-
-		for (count = 0; count < path[type].length; count++) {
-
-			path[type].x[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 3] << 2;
-			path[type].y[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 2];
-
-		}
-
-	}
+	createPaths(buffer);
 	free(buffer);
 	//delete[] buffer;
 
@@ -808,55 +1702,9 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 		#endif
 	}
 	file->loadRLE(EVENTS * ELENGTH,buffer);
+	cacheBytes(buffer, EVENTS * ELENGTH);
 
-	// Fill event set with data
-	for (count = 0; count < EVENTS; count++) {
-
-		eventSet[count].difficulty           = buffer[count * ELENGTH];
-		eventSet[count].reflection           = buffer[(count * ELENGTH) + 2];
-		eventSet[count].movement             = buffer[(count * ELENGTH) + 4];
-		eventSet[count].anims[E_LEFTANIM]    = buffer[(count * ELENGTH) + 5];
-		eventSet[count].anims[E_RIGHTANIM]   = buffer[(count * ELENGTH) + 6];
-		eventSet[count].magnitude            = buffer[(count * ELENGTH) + 8];
-		eventSet[count].strength             = buffer[(count * ELENGTH) + 9];
-		eventSet[count].modifier             = buffer[(count * ELENGTH) + 10];
-		eventSet[count].points               = buffer[(count * ELENGTH) + 11];
-		eventSet[count].bullet               = buffer[(count * ELENGTH) + 12];
-		eventSet[count].bulletPeriod         = buffer[(count * ELENGTH) + 13];
-		eventSet[count].speed                = buffer[(count * ELENGTH) + 15] + 1;
-		eventSet[count].animSpeed            = buffer[(count * ELENGTH) + 17] + 1;
-		eventSet[count].sound                = buffer[(count * ELENGTH) + 21];
-		eventSet[count].multiA               = buffer[(count * ELENGTH) + 22];
-		eventSet[count].multiB               = buffer[(count * ELENGTH) + 23];
-		eventSet[count].pieceSize            = buffer[(count * ELENGTH) + 24];
-		eventSet[count].pieces               = buffer[(count * ELENGTH) + 25];
-		eventSet[count].angle                = buffer[(count * ELENGTH) + 26];
-		eventSet[count].anims[E_LFINISHANIM] = buffer[(count * ELENGTH) + 28];
-		eventSet[count].anims[E_RFINISHANIM] = buffer[(count * ELENGTH) + 29];
-		eventSet[count].anims[E_LSHOOTANIM]  = buffer[(count * ELENGTH) + 30];
-		eventSet[count].anims[E_RSHOOTANIM]  = buffer[(count * ELENGTH) + 31];
-
-	}
-
-	// Process grid
-
-	enemies = items = 0;
-
-	for (x = 0; x < LW; x++) {
-
-		for (y = 0; y < LH; y++) {
-
-			type = getEventType(x, y);
-
-			if (type) {
-
-				// If the event hurts and can be killed, it is an enemy
-				// Anything else that scores is an item
-				if ((eventSet[type].modifier == 0) && eventSet[type].strength) enemies++;
-				else if (eventSet[type].points) items++;
-			}
-		}
-	}
+	createEventSet(buffer);
 	//delete[] buffer;
 	free(buffer);
 
@@ -877,29 +1725,10 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 		#endif
 	}
 	file->loadRLE(ANIMS << 6,buffer);
-	
-	// Create animation set based on that data
-	for (count = 0; count < ANIMS; count++) {
-
-		animSet[count].setData(buffer[(count << 6) + 6],
-			buffer[count << 6], buffer[(count << 6) + 1],
-			buffer[(count << 6) + 3], buffer[(count << 6) + 4],
-			buffer[(count << 6) + 2], buffer[(count << 6) + 5]);
-
-		for (y = 0; y < buffer[(count << 6) + 6]; y++) {
+	cacheBytes(buffer, ANIMS << 6);
 
-			// Get frame
-			x = buffer[(count << 6) + 7 + y];
-			if (x > sprites) x = sprites;
-
-			// Assign sprite and vertical offset
-			animSet[count].setFrame(y, true);
-			animSet[count].setFrameData(spriteSet + x,
-				buffer[(count << 6) + 26 + y], buffer[(count << 6) + 45 + y]);
-
-		}
-
-	}
+	// Create animation set based on that data
+	createAnims(buffer);
 	//delete[] buffer;
 	free(buffer);
 	#ifdef CASIO
@@ -932,6 +1761,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	// End of episode cutscene
 	sceneFile = file->loadString();
+	cacheString(sceneFile);
 
 	// 52 bytes of undiscovered usefulness, less the cutscene file name
 	file->seek(x + 366, true);
@@ -947,10 +1777,17 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	y = file->loadChar();
 	setNext(x, y);
 
+	cacheValue(startX, 1);
+	cacheValue(startY, 1);
+	cacheValue(x, 1);
+	cacheValue(y, 1);
+
 
 	// Thanks to Doubble Dutch for the water level bytes
 	file->seek(4, false);
-	waterLevelTarget = ITOF(file->loadShort() + 17);
+	count = file->loadShort();
+	cacheValue(count, 2);
+	waterLevelTarget = ITOF(count + 17);
 	waterLevel = waterLevelTarget - F8;
 	waterLevelSpeed = -80000;
 
@@ -972,6 +1809,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 		#endif
 	}
 	file->loadRLE(JJ1PANIMS * 2,buffer);
+	cacheBytes(buffer, JJ1PANIMS * 2);
 
 	for (x = 0; x < JJ1PANIMS; x++) {
 
@@ -988,6 +1826,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	miscAnims[1] = file->loadChar();
 	miscAnims[2] = file->loadChar();
 	miscAnims[3] = file->loadChar();
+	cacheBytes(miscAnims, 4);
 
 	// Load bullet set
 	buffer=(unsigned char *)malloc(BULLETS * BLENGTH);
@@ -999,6 +1838,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 		#endif
 	}
 	file->loadRLE(BULLETS * BLENGTH,buffer);
+	cacheBytes(buffer, BULLETS * BLENGTH);
 
 	for (count = 0; count < BULLETS; count++) {
 
@@ -1016,80 +1856,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	// First byte is the background palette effect type
 	type = file->loadChar();
 
-	sky = false;
-
-	switch (type) {
-
-		case 2:
-
-			sky = true;
-
-			// Sky background effect
-			paletteEffects = new SkyPaletteEffect(156, 100, FH, skyPalette, NULL);
-
-			break;
-
-		case 8:
-
-			// Parallaxing background effect
-			paletteEffects = new P2DPaletteEffect(128, 64, FE, NULL);
-
-			break;
-
-		case 9:
-
-			// Diagonal stripes "parallaxing" background effect
-			paletteEffects = new P1DPaletteEffect(128, 32, FH, NULL);
-
-			break;
-
-		case 11:
-
-			// The deeper below water, the darker it gets
-			paletteEffects = new WaterPaletteEffect(TTOF(32), NULL);
-
-			break;
-
-		default:
-
-			// No effect
-			paletteEffects = NULL;
-
-			break;
-
-	}
-
-	// Palette animations
-	// These are applied to every level without a conflicting background effect
-	// As a result, there are a few levels with things animated that shouldn't
-	// be
-
-	// In Diamondus: The red/yellow palette animation
-	paletteEffects = new RotatePaletteEffect(112, 4, F32, paletteEffects);
-
-	// In Diamondus: The waterfall palette animation
-	paletteEffects = new RotatePaletteEffect(116, 8, F16, paletteEffects);
-
-	// The following were discoverd by Unknown/Violet
-
-	paletteEffects = new RotatePaletteEffect(124, 3, F16, paletteEffects);
-
-	if ((type != PE_1D) && (type != PE_2D))
-		paletteEffects = new RotatePaletteEffect(132, 8, F16, paletteEffects);
-
-	if ((type != PE_SKY) && (type != PE_2D))
-		paletteEffects = new RotatePaletteEffect(160, 32, -F16, paletteEffects);
-
-	if (type != PE_SKY) {
-
-		paletteEffects = new RotatePaletteEffect(192, 32, -F32, paletteEffects);
-		paletteEffects = new RotatePaletteEffect(224, 16, F16, paletteEffects);
-
-	}
-
-	// Level fade-in/white-in effect
-	if (checkpoint) paletteEffects = new FadeInPaletteEffect(T_START, paletteEffects);
-	else paletteEffects = new WhiteInPaletteEffect(T_START, paletteEffects);
+	createEffects(type, checkpoint);
 
 
 	// Check if a sun/star/distant planet, etc. is visible
@@ -1106,19 +1873,17 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	miscAnims[MA_LBOARD] = file->loadChar();
 	miscAnims[MA_RBOARD] = file->loadChar();
 
+	cacheValue(type, 1);
+	cacheValue(skyOrb, 1);
+	cacheValue(miscAnims[MA_LBOARD], 1);
+	cacheValue(miscAnims[MA_RBOARD], 1);
+
 
 	// And that's us done!
 
 	delete file;
 
-	// Set the tick at which the level will end
-	endTime = (5 - game->getDifficulty()) * 2 * 60 * 1000;
-
-	events = NULL;
-	bullets = NULL;
-	energyBar = 0;
-	ammoType = 0;
-	ammoOffset = -1;
+	saveCache(fileName, levelStamp);
 
 	#ifdef CASIO
 		drawStrL(2,"Done");
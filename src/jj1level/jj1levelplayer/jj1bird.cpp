@@ -59,12 +59,10 @@ JJ1Bird::JJ1Bird (JJ1Bird* birds, JJ1LevelPlayer *rescuer, unsigned char gX, uns
 
 
 /**
- * Delete all birds.
+ * Delete bird.
  */
 JJ1Bird::~JJ1Bird () {
 
-	if (next) delete next;
-
 	return;
 
 }
@@ -135,9 +133,14 @@ int JJ1Bird::getFlockSize () {
  */
 JJ1Bird* JJ1Bird::setFlockSize (int size) {
 
+	JJ1Bird* bird;
+
 	if (size <= 0) {
 
-		delete this;
+		bird = this;
+
+		while (bird) bird = bird->remove();
+
 		return NULL;
 
 	}
@@ -167,10 +170,9 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 	Movable* leader;
 	JJ1Event* event;
 	bool target;
+	int count;
 
-	// Process the next bird
-	if (next) next = next->step(ticks);
-
+	// The next bird has already been processed
 	if (next) leader = next;
 	else leader = player;
 
@@ -247,28 +249,16 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 			// Check for nearby targets
 
 			target = false;
-			event = level->getEvents();
 
-			if (player->getFacing()) {
+			for (count = level->countEvents() - 1; (count >= 0) && !target; count--) {
 
-				while (event && !target) {
+				event = level->getActiveEvent(count);
 
+				if (player->getFacing())
 					target = event->isEnemy() && event->overlap(x, y, F160, F100);
-
-					event = event->getNext();
-
-				}
-
-			} else {
-
-				while (event && !target) {
-
+				else
 					target = event->isEnemy() && event->overlap(x - F160, y, F160, F100);
 
-					event = event->getNext();
-
-				}
-
 			}
 
 			// If there is a target in the vicinity, generate bullets
@@ -310,8 +300,6 @@ void JJ1Bird::draw (unsigned int ticks, int change) {
 
 	Anim *anim;
 
-	if (next) next->draw(ticks, change);
-
 	anim = level->getAnim((player->getFacing() || fleeing)? BIRD_RIGHTANIM: BIRD_LEFTANIM);
 	anim->setFrame(ticks / 80, true);
 
@@ -58,6 +58,9 @@ class JJ1Bird : public Movable {
 
 		JJ1Bird* remove ();
 
+		friend class JJ1LevelPlayer;
+		template <class T> friend class MovableList;
+
 	public:
 		JJ1Bird  (JJ1Bird* birds, JJ1LevelPlayer* player, unsigned char gX, unsigned char gY);
 		~JJ1Bird ();
@@ -135,7 +135,7 @@ JJ1LevelPlayer::JJ1LevelPlayer (Player* parent, Anim** newAnims, unsigned char s
  */
 JJ1LevelPlayer::~JJ1LevelPlayer () {
 
-	if (birds) delete birds;
+	while (birds) birds = birds->remove();
 
 	return;
 
@@ -162,6 +162,8 @@ class JJ1LevelPlayer : public LevelPlayer {
 
 		bool checkMaskDown (fixed yOffset);
 		bool checkMaskUp   (fixed yOffset);
+		int  sweepDown     (fixed yOffset, int steps);
+		int  sweepUp       (fixed yOffset, int steps);
 
 		void ground ();
 
@@ -80,6 +80,44 @@ bool JJ1LevelPlayer::checkMaskUp (fixed yOffset) {
 }
 
 
+/**
+ * Find how far the player can travel downwards, in steps of F4, before the
+ * area below the player is solid.
+ *
+ * @param yOffset Vertical offset of the first mask values to check
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the area is solid (steps if never)
+ */
+int JJ1LevelPlayer::sweepDown (fixed yOffset, int steps) {
+
+	steps = level->sweepDown(x + PXO_ML + F1, y + yOffset, steps);
+	steps = level->sweepDown(x + PXO_MID, y + yOffset, steps);
+
+	return level->sweepDown(x + PXO_MR - F1, y + yOffset, steps);
+
+}
+
+
+/**
+ * Find how far the player can travel upwards, in steps of F4, before the area
+ * above the player is solid.
+ *
+ * @param yOffset Vertical offset of the first mask values to check
+ * @param steps Maximum number of steps
+ *
+ * @return Number of steps before the area is solid (steps if never)
+ */
+int JJ1LevelPlayer::sweepUp (fixed yOffset, int steps) {
+
+	steps = level->sweepUp(x + PXO_ML + F1, y + yOffset, steps);
+	steps = level->sweepUp(x + PXO_MID, y + yOffset, steps);
+
+	return level->sweepUp(x + PXO_MR - F1, y + yOffset, steps);
+
+}
+
+
 /**
  * Move the player to the ground's surface.
  */
@@ -103,6 +141,7 @@ void JJ1LevelPlayer::ground () {
  */
 void JJ1LevelPlayer::control (unsigned int ticks) {
 
+	JJ1Bird* bird;
 	fixed speed;
 	bool platform;
 
@@ -407,12 +446,13 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 			if (player->ammoType == 4) {
 
 				JJ1Event* event;
+				int count;
 
 				// TNT
 
-				event = level->getEvents();
+				for (count = level->countEvents() - 1; count >= 0; count--) {
 
-				while (event) {
+					event = level->getActiveEvent(count);
 
 					// If the event is within range, hit it
 					if (event->overlap(x - F160, y - F100, 2 * F160, 2 * F100)) {
@@ -421,8 +461,6 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 
 					}
 
-					event = event->getNext();
-
 				}
 
 				// Red flash
@@ -476,7 +514,13 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 
 	// Deal with the bird
 
-	if (birds) birds = birds->step(ticks);
+	if (birds) {
+
+		MovableList<JJ1Bird> birdList(&birds);
+
+		while ((bird = birdList.next())) birdList.replace(bird->step(ticks));
+
+	}
 
 
 	return;
@@ -493,7 +537,7 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 	fixed pdx, pdy;
 	bool grounded = false;
-	int count;
+	int count, steps;
 
 	if (warpTime && (ticks > warpTime)) {
 
@@ -526,20 +570,18 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = (-pdy) >> 12;
 
-		while (count > 0) {
+		if (count > 0) {
 
-			if (checkMaskUp(PYO_TOP - F4)) {
+			steps = sweepUp(PYO_TOP - F4, count);
+			y -= steps * F4;
+
+			if (steps < count) {
 
 				y &= ~4095;
 				dy = 0;
 
-				break;
-
 			}
 
-			y -= F4;
-			count--;
-
 		}
 
 		pdy = (-pdy) & 4095;
@@ -559,20 +601,18 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 			count = pdy >> 12;
 
-			while (count > 0) {
+			if (count > 0) {
 
-				if (checkMaskDown(F4)) {
+				steps = sweepDown(F4, count);
+				y += steps * F4;
+
+				if (steps < count) {
 
 					y |= 4095;
 					dy = 0;
 
-					break;
-
 				}
 
-				y += F4;
-				count--;
-
 			}
 
 			pdy &= 4095;
@@ -617,24 +657,33 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = (-pdx) >> 12;
 
-		while (count > 0) {
+		if (grounded) {
 
-			// If there is an obstacle, stop
-			if (level->checkMaskUp(x + PXO_L - F4, y + PYO_MID)) {
+			// Each step can change the height, so take one step at a time
+			while ((count > 0) && !level->checkMaskUp(x + PXO_L - F4, y + PYO_MID)) {
 
-				x &= ~4095;
-				dx = 0;
-
-				if (udx < -PXS_RUN) udx = -PXS_RUN;
+				x -= F4;
+				count--;
 
-				break;
+				ground();
 
 			}
 
-			x -= F4;
-			count--;
+		} else if (count > 0) {
+
+			steps = level->sweepLeft(x + PXO_L - F4, y + PYO_MID, count);
+			x -= steps * F4;
+			count -= steps;
 
-			if (grounded) ground();
+		}
+
+		// If there is an obstacle, stop
+		if (count > 0) {
+
+			x &= ~4095;
+			dx = 0;
+
+			if (udx < -PXS_RUN) udx = -PXS_RUN;
 
 		}
 
@@ -657,24 +706,33 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = pdx >> 12;
 
-		while (count > 0) {
+		if (grounded) {
 
-			// If there is an obstacle, stop
-			if (level->checkMaskUp(x + PXO_R + F4, y + PYO_MID)) {
+			// Each step can change the height, so take one step at a time
+			while ((count > 0) && !level->checkMaskUp(x + PXO_R + F4, y + PYO_MID)) {
 
-				x |= 4095;
-				dx = 0;
-
-				if (udx > PXS_RUN) udx = PXS_RUN;
+				x += F4;
+				count--;
 
-				break;
+				ground();
 
 			}
 
-			x += F4;
-			count--;
+		} else if (count > 0) {
+
+			steps = level->sweepRight(x + PXO_R + F4, y + PYO_MID, count);
+			x += steps * F4;
+			count -= steps;
+
+		}
+
+		// If there is an obstacle, stop
+		if (count > 0) {
+
+			x |= 4095;
+			dx = 0;
 
-			if (grounded) ground();
+			if (udx > PXS_RUN) udx = PXS_RUN;
 
 		}
 
@@ -840,6 +898,7 @@ void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
  */
 void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 
+	JJ1Bird* bird;
 	Anim *an;
 	int frame;
 	fixed drawX, drawY;
@@ -967,7 +1026,13 @@ void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 
 
 	// Show the bird
-	if (birds) birds->draw(ticks, change);
+	if (birds) {
+
+		MovableList<JJ1Bird> birdList(&birds);
+
+		while ((bird = birdList.next())) bird->draw(ticks, change);
+
+	}
 
 
 	// Show the player's name
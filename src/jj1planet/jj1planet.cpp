@@ -110,6 +110,8 @@ JJ1Planet::JJ1Planet (char * fileName, int previous) {
  */
 JJ1Planet::~JJ1Planet () {
 
+	spriteCache.flush();
+
 	delete[] name;
 
 	return;
@@ -168,11 +170,11 @@ int JJ1Planet::play () {
 		unsigned tickDiff = globalTicks - tickOffset;
 
 		if (tickDiff < F2)
-			sprite.drawScaled(canvasW >> 1, canvasH >> 1, globalTicks - tickOffset);
+			sprite.drawCached(canvasW >> 1, canvasH >> 1, globalTicks - tickOffset);
 		else if (tickDiff < F4)
-			sprite.drawScaled(canvasW >> 1, canvasH >> 1, F2);
+			sprite.drawCached(canvasW >> 1, canvasH >> 1, F2);
 		else if (tickDiff < F4 + FQ)
-			sprite.drawScaled(canvasW >> 1, canvasH >> 1, (globalTicks - tickOffset - F4) * 32 + F2);
+			sprite.drawCached(canvasW >> 1, canvasH >> 1, (globalTicks - tickOffset - F4) * 32 + F2);
 		else  {
 			return E_NONE;
 		}
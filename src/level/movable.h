@@ -27,8 +27,16 @@
 
 #include "OpenJazz.h"
 
+#include <stddef.h>
 
-// Class
+
+// Constant
+
+// Number of list entries gathered per pass by MovableList
+#define LIST_CHUNK 32
+
+
+// Classes
 
 /// Base class for all movable objects (players, events, bullets, birds)
 class Movable {
@@ -45,6 +53,186 @@ class Movable {
 
 };
 
+/// Sizes seen while walking a kind of list
+struct ListStats {
+
+	unsigned int maxLength; ///< Most entries walked in one go
+	unsigned int maxPasses; ///< Most passes needed for one walk
+	unsigned int walks; ///< Number of walks
+
+};
+
+/// Walks a linked list of birds from its oldest (last) entry to its newest
+/// (first), the order in which they have always been stepped and drawn,
+/// without recursing. Entries are gathered LIST_CHUNK at a
+/// time from the end of the list, so the stack used does not depend on the
+/// length of the list. Entries added to the head during the walk are left
+/// alone.
+template <class T> class MovableList {
+
+	private:
+		T**  head; ///< The list's head
+		T*   first; ///< Newest entry when the walk began
+		T*   stop; ///< Oldest entry not to gather, or NULL
+		T*   before; ///< Entry linking to the gathered entries, or NULL
+		T*   chunk[LIST_CHUNK]; ///< Gathered entries, newest first
+		T*   current; ///< Entry last returned
+		int  count; ///< Gathered entries not yet returned
+		int  length; ///< Entries walked so far
+		int  passes; ///< Passes made so far
+		bool done; ///< Whether or not the newest entry has been gathered
+
+		void gather ();
+
+	public:
+		static ListStats stats;
+
+		MovableList  (T** listHead);
+		~MovableList ();
+
+		T*   next    ();
+		void replace (T* entry);
+
+};
+
+
+template <class T> ListStats MovableList<T>::stats;
+
+
+/**
+ * Start walking a list.
+ *
+ * @param listHead The list's head
+ */
+template <class T> MovableList<T>::MovableList (T** listHead) {
+
+	head = listHead;
+	first = *listHead;
+	stop = NULL;
+	before = NULL;
+	current = NULL;
+	count = 0;
+	length = 0;
+	passes = 0;
+	done = !first;
+
+	return;
+
+}
+
+
+/**
+ * Finish walking a list.
+ */
+template <class T> MovableList<T>::~MovableList () {
+
+	if (length > (int)stats.maxLength) stats.maxLength = length;
+	if (passes > (int)stats.maxPasses) stats.maxPasses = passes;
+	stats.walks++;
+
+	return;
+
+}
+
+
+/**
+ * Gather the oldest entries not yet walked.
+ */
+template <class T> void MovableList<T>::gather () {
+
+	T* lead;
+	T* entry;
+	int entries;
+
+	// Stop where the previous pass started, at whatever now follows the entry
+	// linking to it
+	if (passes) stop = before? before->next: NULL;
+
+	// Find the last LIST_CHUNK entries before the stopping point
+	lead = first;
+
+	for (entries = 0; (entries < LIST_CHUNK) && (lead != stop); entries++)
+		lead = lead->next;
+
+	entry = first;
+	before = NULL;
+
+	while (lead != stop) {
+
+		lead = lead->next;
+		before = entry;
+		entry = entry->next;
+
+	}
+
+	for (count = 0; count < entries; count++) {
+
+		chunk[count] = entry;
+		entry = entry->next;
+
+	}
+
+	if (!before) done = true;
+
+	length += entries;
+	passes++;
+
+	return;
+
+}
+
+
+/**
+ * Get the next entry, oldest first.
+ *
+ * @return The entry (NULL if there are none left)
+ */
+template <class T> T* MovableList<T>::next () {
+
+	if (!count) {
+
+		if (done) return NULL;
+
+		gather();
+
+	}
+
+	current = chunk[--count];
+
+	return current;
+
+}
+
+
+/**
+ * Replace the entry last returned, e.g. with its own next entry once it has
+ * removed itself.
+ *
+ * @param entry The replacement
+ */
+template <class T> void MovableList<T>::replace (T* entry) {
+
+	T** link;
+
+	if (entry == current) return;
+
+	if (count) link = &(chunk[count - 1]->next);
+	else if (before) link = &(before->next);
+	else {
+
+		// Entries may have been added ahead of the newest
+		link = head;
+
+		while (*link != current) link = &((*link)->next);
+
+	}
+
+	*link = entry;
+
+	return;
+
+}
+
 
 #endif
 
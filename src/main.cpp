@@ -50,6 +50,9 @@
 #include "mem.h"
 #include "jj1planet/jj1planet.h"
 #include "io/gfx/sprite.h"
+#ifdef BENCHMARK
+	#include "benchmark.h"
+#endif
 #if defined(CAANOO) || defined(WIZ) || defined(GP2X)
 	#include "platforms/wiz.h"
 #elif defined(CASIO)
@@ -438,7 +441,11 @@ int loop (LoopType type, PaletteEffect* paletteEffects) {
 #else
 	// Process system events
 	ret=E_NONE;
+	#ifdef PRESENT_THREAD
+	while (video.pollEvent(&event)){
+	#else
 	while (SDL_PollEvent(&event)){
+	#endif
 		if (event.type == SDL_QUIT) return E_QUIT;
 		ret = controls.update(&event, type);
 		video.update(&event);
@@ -446,6 +453,7 @@ int loop (LoopType type, PaletteEffect* paletteEffects) {
 #endif
 	if (ret != E_NONE) return ret;
 	controls.loop();
+	prefetchStep();
 	return E_NONE;
 
 }
@@ -463,7 +471,12 @@ unsigned char __attribute__((aligned(sizeof(uintptr_t)))) SaveVramAddr[384 * 216
  * Initializes SDL and launches game.
  */
 uint16_t* vramAddress;
+#ifdef BENCHMARK
+int main(int argc, char** argv){
+	int ret;
+#else
 int main(void){
+#endif
 	//Main* mainObj;
 	#ifdef CASIO
 		Bdisp_EnableColor(1);
@@ -475,6 +488,12 @@ int main(void){
 		SaveVramAddr=(unsigned char*)GetSecondaryVRAMAddress();
 		if(HackRET(SaveVramAddr)&3)
 			SaveVramAddr+=4-(HackRET(SaveVramAddr)&3);//Align address
+	#elif defined(BENCHMARK)
+		// No window, sound or input is needed
+		if (SDL_Init(SDL_INIT_TIMER) < 0) {
+			logError("Could not start SDL", SDL_GetError());
+			return -1;
+		}
 	#else
 		// Initialize SDL
 		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK | SDL_INIT_TIMER) < 0) {
@@ -489,8 +508,13 @@ int main(void){
 	{
 	Main mainObj;
 
+#ifdef BENCHMARK
+	// Time a demo instead of running the menus
+	ret = runBenchmark(argc, argv);
+#else
 	// Play the opening cutscene, run the main menu, etc.
 	mainObj.play();
+#endif
 	}
 	// Save configuration and shut down
 
@@ -508,7 +532,13 @@ int main(void){
 		GetKey(&key);
 	}
 #else
+	#ifdef PRESENT_THREAD
+	video.stopPresenting();
+	#endif
 	SDL_Quit();
+#endif
+#ifdef BENCHMARK
+	return (ret < 0)? 1: 0;
 #endif
 	//return ret;
 }
@@ -8,10 +8,13 @@
 #endif
 struct memobj objs[MAXOBJ];
 
+#ifndef MEM_ARENA
 static unsigned cursize[2];
 static unsigned objamt=0;
+#endif
+static struct memstats stats;
 
-static unsigned char heapdat[MAXMEM];
+static unsigned char __attribute__((aligned(8))) heapdat[MAXMEM];
 objid_t * idptrs[MAXOBJ];//When freeing object it is going to change the "id" of other objects so these will need to be updated pointer appears to be the best solution
 
 unsigned int allowUseSecondaryVramAsHeap;
@@ -24,10 +27,303 @@ extern unsigned char SaveVramAddr[];
 static unsigned char * heapPtrs[2];
 static const unsigned memoryLimits[2] = {MAXMEM, MAXMEM2};
 
+static void countUsed(int change){
+	stats.used+=change;
+	if(stats.used>stats.peak)
+		stats.peak=stats.used;
+	if(stats.objects>stats.peakObjects)
+		stats.peakObjects=stats.objects;
+}
+#ifdef MEM_ARENA
+/* Each heap is a row of blocks, each starting with a header giving its own
+size and the size of the block before it, so a freed block can be merged with
+both neighbours straight away. Free blocks are also kept in lists by size
+class (the highest set bit of the size), and a bitmap of non-empty lists
+finds a big enough block without walking the heap. */
+#define ARENA_HEADER 8
+#define ARENA_MINBLOCK 16
+#define ARENA_CLASSES 32
+#define ARENA_USED 1
+#define ARENA_NONE 0xFFFFFFFF
+
+struct arenablock{
+	unsigned size;//Including the header, the lowest bit is set when in use
+	unsigned prevSize;//Size of the block before this one, 0 for the first
+	//Only valid while the block is free
+	unsigned nextFree;
+	unsigned prevFree;
+};
+struct arena{
+	unsigned freeLists[ARENA_CLASSES];//Offset of the first block in each list
+	unsigned freeClasses;//Bit set for each non-empty list
+	unsigned freeBytes;
+	unsigned freeBlocks;
+	unsigned objects;
+};
+static struct arena arenas[2];
+static objid_t freeIds[MAXOBJ];
+static unsigned freeIdAmt;
+
+#define BLOCK(heap,off) ((struct arenablock *)(heapPtrs[heap]+(off)))
+#define BLOCKSIZE(b) ((b)->size&~ARENA_USED)
+
+static unsigned sizeClass(unsigned size){
+	unsigned c=0;
+	while(size>>=1)
+		++c;
+	return c;
+}
+static void unlinkFree(unsigned heap,unsigned off){
+	struct arena * a=&arenas[heap];
+	struct arenablock * b=BLOCK(heap,off);
+	unsigned c=sizeClass(b->size);
+	if(b->prevFree!=ARENA_NONE)
+		BLOCK(heap,b->prevFree)->nextFree=b->nextFree;
+	else{
+		a->freeLists[c]=b->nextFree;
+		if(b->nextFree==ARENA_NONE)
+			a->freeClasses&=~(1U<<c);
+	}
+	if(b->nextFree!=ARENA_NONE)
+		BLOCK(heap,b->nextFree)->prevFree=b->prevFree;
+	a->freeBytes-=b->size;
+	--a->freeBlocks;
+}
+static void linkFree(unsigned heap,unsigned off){
+	struct arena * a=&arenas[heap];
+	struct arenablock * b=BLOCK(heap,off);
+	unsigned c=sizeClass(b->size);
+	b->prevFree=ARENA_NONE;
+	b->nextFree=a->freeLists[c];
+	if(b->nextFree!=ARENA_NONE)
+		BLOCK(heap,b->nextFree)->prevFree=off;
+	a->freeLists[c]=off;
+	a->freeClasses|=1U<<c;
+	a->freeBytes+=b->size;
+	++a->freeBlocks;
+}
+static void setPrevSize(unsigned heap,unsigned off,unsigned size){
+	//Tell the next block, if there is one, how big this one is
+	if((off+size)<memoryLimits[heap])
+		BLOCK(heap,off+size)->prevSize=size;
+}
+static void formatArena(unsigned heap){
+	struct arenablock * b;
+	unsigned c;
+	for(c=0;c<ARENA_CLASSES;++c)
+		arenas[heap].freeLists[c]=ARENA_NONE;
+	arenas[heap].freeClasses=0;
+	arenas[heap].freeBytes=0;
+	arenas[heap].freeBlocks=0;
+	arenas[heap].objects=0;
+	b=BLOCK(heap,0);
+	b->size=memoryLimits[heap]&~(ARENA_HEADER-1);
+	b->prevSize=0;
+	linkFree(heap,0);
+}
+static unsigned blockSize(unsigned size){
+	size=(size+ARENA_HEADER+(ARENA_HEADER-1))&~(ARENA_HEADER-1);
+	return size<ARENA_MINBLOCK?ARENA_MINBLOCK:size;
+}
+/* Give the end of a used block back to the free lists, if it is worth
+keeping */
+static void trimBlock(unsigned heap,unsigned off,unsigned need){
+	struct arenablock * b=BLOCK(heap,off);
+	struct arenablock * rest;
+	unsigned size=BLOCKSIZE(b);
+	unsigned restOff=off+need;
+	if(size-need<ARENA_MINBLOCK)
+		return;
+	b->size=need|ARENA_USED;
+	rest=BLOCK(heap,restOff);
+	rest->size=size-need;
+	rest->prevSize=need;
+	//Merge with a free block after it
+	if(((restOff+rest->size)<memoryLimits[heap])&&!(BLOCK(heap,restOff+rest->size)->size&ARENA_USED)){
+		unsigned nextSize=BLOCK(heap,restOff+rest->size)->size;
+		unlinkFree(heap,restOff+rest->size);
+		rest->size+=nextSize;
+	}
+	setPrevSize(heap,restOff,rest->size);
+	linkFree(heap,restOff);
+}
+static unsigned allocBlock(unsigned heap,unsigned need){
+	struct arena * a=&arenas[heap];
+	unsigned c=sizeClass(need);
+	unsigned off,classes;
+	//Blocks in the same class might still be too small, so try them first
+	for(off=a->freeLists[c];off!=ARENA_NONE;off=BLOCK(heap,off)->nextFree){
+		if(BLOCK(heap,off)->size>=need)
+			break;
+	}
+	if(off==ARENA_NONE){
+		//Every block in a higher class is big enough
+		classes=(c+1<ARENA_CLASSES)?(a->freeClasses&~((2U<<c)-1)):0;
+		if(!classes)
+			return ARENA_NONE;
+		off=a->freeLists[__builtin_ctz(classes)];
+	}
+	unlinkFree(heap,off);
+	BLOCK(heap,off)->size|=ARENA_USED;
+	trimBlock(heap,off,need);
+	++a->objects;
+	return off;
+}
+static void freeBlock(unsigned heap,unsigned off){
+	struct arenablock * b=BLOCK(heap,off);
+	unsigned size=BLOCKSIZE(b);
+	unsigned next;
+	--arenas[heap].objects;
+	//Merge with free neighbours
+	if(((off+size)<memoryLimits[heap])&&!(BLOCK(heap,off+size)->size&ARENA_USED)){
+		next=off+size;
+		unlinkFree(heap,next);
+		size+=BLOCK(heap,next)->size;
+	}
+	if(b->prevSize&&!(BLOCK(heap,off-b->prevSize)->size&ARENA_USED)){
+		off-=b->prevSize;
+		unlinkFree(heap,off);
+		size+=BLOCK(heap,off)->size;
+		b=BLOCK(heap,off);
+	}
+	b->size=size;
+	setPrevSize(heap,off,size);
+	linkFree(heap,off);
+}
+static void arenaFail(const char * what,unsigned size){
+	#ifdef CASIO
+		casioQuit(what);
+	#else
+		printf("%s while adding %d bytes, %d bytes free in %d blocks\n",what,size,arenas[0].freeBytes,arenas[0].freeBlocks);
+		exit(-1);
+	#endif
+}
+static void placeObj(objid_t id,unsigned size,unsigned * heap,unsigned * off){
+	unsigned need=blockSize(size);
+	*heap=0;
+	*off=allocBlock(0,need);
+	if((*off==ARENA_NONE)&&allowUseSecondaryVramAsHeap){
+		//The secondary heap is shared with the level, so it only holds anything while in use
+		if(!arenas[1].objects)
+			formatArena(1);
+		*heap=1;
+		*off=allocBlock(1,need);
+	}
+	if(*off==ARENA_NONE)
+		arenaFail("Out of stack for addojb allocator",size);
+	objs[id].ptr=heapPtrs[*heap]+*off+ARENA_HEADER;
+	objs[id].memb=*off;
+	objs[id].heapIdx=*heap;
+}
+#endif
 void initMemHeap(void) {
 	heapPtrs[0] = heapdat;
 	heapPtrs[1] = SaveVramAddr;
+#ifdef MEM_ARENA
+	unsigned x;
+	formatArena(0);
+	for(x=0;x<MAXOBJ;++x)
+		freeIds[x]=MAXOBJ-1-x;
+	freeIdAmt=MAXOBJ;
+#endif
 }
+void getMemStats(struct memstats * out){
+	*out=stats;
+#ifdef MEM_ARENA
+	out->freeBytes=arenas[0].freeBytes;
+	out->freeBlocks=arenas[0].freeBlocks;
+	out->largestFree=0;
+	if(arenas[0].freeClasses){
+		//Only the largest non-empty class needs to be searched
+		unsigned off=arenas[0].freeLists[31-__builtin_clz(arenas[0].freeClasses)];
+		for(;off!=ARENA_NONE;off=BLOCK(0,off)->nextFree){
+			if(BLOCK(0,off)->size-ARENA_HEADER>out->largestFree)
+				out->largestFree=BLOCK(0,off)->size-ARENA_HEADER;
+		}
+	}
+#else
+	out->freeBytes=MAXMEM-cursize[0];
+	out->freeBlocks=out->freeBytes?1:0;
+	out->largestFree=out->freeBytes;
+#endif
+}
+#ifdef MEM_ARENA
+void addobj(unsigned size,objid_t * id){
+	unsigned heap,off;
+	if(!freeIdAmt){
+		#ifdef CASIO
+			casioQuit("Out of objects");
+		#else
+			puts("Out of objects");
+			exit(-1);
+		#endif
+		return;
+	}
+	*id=freeIds[--freeIdAmt];
+	placeObj(*id,size,&heap,&off);
+	objs[*id].size=size;
+	idptrs[*id]=id;
+	++stats.objects;
+	countUsed(BLOCKSIZE(BLOCK(heap,off)));
+}
+void freeobj(objid_t obj){
+	unsigned heap=objs[obj].heapIdx;
+	unsigned off=objs[obj].memb;
+	countUsed(-(int)BLOCKSIZE(BLOCK(heap,off)));
+	--stats.objects;
+	freeBlock(heap,off);
+	objs[obj].ptr=NULL;
+	idptrs[obj]=NULL;
+	freeIds[freeIdAmt++]=obj;
+}
+void resizeobj(objid_t obj, int newamt){
+	unsigned heap=objs[obj].heapIdx;
+	unsigned off=objs[obj].memb;
+	struct arenablock * b=BLOCK(heap,off);
+	unsigned size=BLOCKSIZE(b);
+	unsigned used=size;
+	unsigned need,next,oldHeap,oldOff,oldSize;
+	if(newamt<=0){
+		#ifdef CASIO
+			casioQuit("Cannot resize object to x<=0");
+		#else
+			printf("Cannot resize object to %d\n",newamt);
+			exit(-1);
+		#endif
+	}
+	need=blockSize(newamt);
+	if(need>size){
+		//Grow into a free block after this one if possible
+		next=off+size;
+		if((next<memoryLimits[heap])&&!(BLOCK(heap,next)->size&ARENA_USED)&&
+			(size+BLOCK(heap,next)->size>=need)){
+			size+=BLOCK(heap,next)->size;
+			unlinkFree(heap,next);
+			b->size=size|ARENA_USED;
+			setPrevSize(heap,off,size);
+		}else{
+			//Otherwise this object has to move
+			#ifndef CASIO
+				printf("Resizing and moving object %d from %d bytes to %d bytes\n",obj,objs[obj].size,newamt);
+			#endif
+			oldHeap=heap;
+			oldOff=off;
+			oldSize=objs[obj].size;
+			placeObj(obj,newamt,&heap,&off);
+			memcpy(objs[obj].ptr,heapPtrs[oldHeap]+oldOff+ARENA_HEADER,oldSize);
+			stats.moved+=oldSize;
+			countUsed(BLOCKSIZE(BLOCK(heap,off))-(int)BLOCKSIZE(BLOCK(oldHeap,oldOff)));
+			freeBlock(oldHeap,oldOff);
+			objs[obj].size=newamt;
+			return;
+		}
+	}
+	countUsed(-(int)used);
+	trimBlock(heap,off,need);
+	countUsed(BLOCKSIZE(b));
+	objs[obj].size=newamt;
+}
+#else
 
 void addobj(unsigned size,objid_t * id){
 	unsigned useHeap = 0;
@@ -57,6 +353,8 @@ void addobj(unsigned size,objid_t * id){
 		#endif
 		return;
 	}
+	++stats.objects;
+	countUsed(size);
 	objs[objamt].size = size;
 	objs[objamt].ptr = heapPtrs[useHeap] + cursize[useHeap];
 	objs[objamt].memb = cursize[useHeap];
@@ -81,11 +379,14 @@ void freeobj(objid_t obj){
 	unsigned useHeap = objs[obj].heapIdx;
 	unsigned char * heapPtr = heapPtrs[useHeap];
 
+	--stats.objects;
+	countUsed(-(int)objs[obj].size);
 	if(obj!=(objamt-1)){
 		unsigned removedbytes=objs[obj].size;
 		--objamt;
 		idptrs[obj][0]=INVALID_OBJ;
 		memmove(heapPtr+(objs[obj].memb),heapPtr+(objs[obj+1].memb),cursize[useHeap]-(objs[obj+1].memb));
+		stats.moved+=cursize[useHeap]-(objs[obj+1].memb);
 		memmove(&idptrs[obj],&idptrs[obj+1],(objamt-obj)*sizeof(objid_t *));
 		cursize[useHeap]-=objs[obj].size;
 		memmove(&objs[obj],&objs[obj+1],(objamt-obj)*sizeof(struct memobj));
@@ -126,12 +427,14 @@ void resizeobj(objid_t obj, int newamt){
 		#endif
 		return;
 	}
+	countUsed(change);
 	if(obj!=(objamt-1)){
 		#ifndef CASIO
 			printf("Resizing and moving object %d from %d bytes to %d bytes\n",obj,objs[obj].size,newamt);
 		#endif
 		int x;
 		memmove(heapPtr+(objs[obj+1].memb)+change,heapPtr+(objs[obj+1].memb),cursize[useHeap]-(objs[obj+1].memb));
+		stats.moved+=cursize[useHeap]-(objs[obj+1].memb);
 		cursize[useHeap]-=objs[obj].size;
 		objs[obj].size=newamt;
 		cursize[useHeap]+=newamt;
@@ -147,3 +450,4 @@ void resizeobj(objid_t obj, int newamt){
 		cursize[useHeap]+=newamt;
 	}
 }
+#endif
@@ -9,11 +9,30 @@ struct memobj{
 	unsigned heapIdx;
 };
 
-#define MAXOBJ 64
+/* With MEM_ARENA, objects never move unless they are resized past a used
+neighbour, so an id stays valid without being rewritten and a free costs the
+same however large the heap is. Without it, freeing or resizing an object
+compacts the heap behind it. */
+#ifdef MEM_ARENA
+	#define MAXOBJ 254
+#else
+	#define MAXOBJ 64
+#endif
 #define MAXMEM (384*1024)
 #define MAXMEM2 (384 * 216 * 2)
 #define INVALID_OBJ (MAXOBJ+1)
 
+struct memstats{
+	unsigned int used;//Bytes taken by objects, including any block headers
+	unsigned int peak;//Highest value of used
+	unsigned int objects;
+	unsigned int peakObjects;
+	unsigned int freeBytes;//Free bytes in the main heap
+	unsigned int largestFree;//Largest object the main heap can still hold
+	unsigned int freeBlocks;//Number of separate free areas in the main heap
+	unsigned int moved;//Bytes copied to make room since start up
+};
+
 extern struct memobj objs[MAXOBJ];
 typedef unsigned char objid_t;
 extern objid_t * idptrs[MAXOBJ];
@@ -24,6 +43,7 @@ void addobj(unsigned int size,objid_t * id);
 void freeobj(objid_t obj);
 void resizeobj(objid_t obj, int newamt);
 void initMemHeap(void);
+void getMemStats(struct memstats * stats);
 #ifdef __cplusplus
 }
 #endif
@@ -1,10 +1,202 @@
 #include "surface.h"
 #include "io/gfx/video.h"
+#include <stdint.h>
 #include <string.h>
+#if defined(__SSE2__) && !defined(CASIO)
+	#include <emmintrin.h>
+	#define BLIT_SSE2
+#elif defined(__ARM_NEON) && !defined(CASIO)
+	#include <arm_neon.h>
+	#define BLIT_NEON
+#endif
 
 #ifndef CASIO
 #include <SDL/SDL.h>
 #endif
+#ifdef BENCHMARK
+#include <stdio.h>
+#endif
+unsigned short canvasDamage[DAMAGE_H];
+static bool damageOn=false;
+static int damageX,damageY;
+/* While tracking is on, every blit records which cells of the tile grid it
+touched. The offset is the position of the canvas within the first cell, so
+cells line up with the level's tiles. */
+void startDamage(int xOffset,int yOffset){
+	damageOn=true;
+	damageX=xOffset;
+	damageY=yOffset;
+}
+void stopDamage(void){
+	damageOn=false;
+}
+void markDamage(int x,int y,int w,int h){
+	if(!damageOn)
+		return;
+	if(x<0){
+		w+=x;
+		x=0;
+	}
+	if(y<0){
+		h+=y;
+		y=0;
+	}
+	if(w>(canvasW-x))
+		w=canvasW-x;
+	if(h>(canvasH-y))
+		h=canvasH-y;
+	if((w<1)||(h<1))
+		return;
+	int x0=(x+damageX)>>5;
+	int x1=(x+w-1+damageX)>>5;
+	int y0=(y+damageY)>>5;
+	int y1=(y+h-1+damageY)>>5;
+	if(x1>=DAMAGE_W)
+		x1=DAMAGE_W-1;
+	if(y1>=DAMAGE_H)
+		y1=DAMAGE_H-1;
+	unsigned short bits=((2<<x1)-1)&~((1<<x0)-1);
+	while(y0<=y1)
+		canvasDamage[y0++]|=bits;
+}
+/* Colour keyed row copies. Where SIMD is available 16 pixels are handled at a
+time, otherwise 4 at a time in a 32-bit word. Both give exactly the same
+result as testing each pixel against the key. */
+typedef uint32_t __attribute__((__may_alias__)) blitWord;
+static inline uint32_t opaqueMask(uint32_t pixels,uint32_t key4){
+	//0xFF in each byte which differs from the key, 0 elsewhere
+	uint32_t x=pixels^key4;
+	x=(((x&0x7F7F7F7F)+0x7F7F7F7F)|x)&0x80808080;
+	return (x>>7)*0xFF;
+}
+static inline void blitRowKeyedBytes(unsigned char * __restrict__ dst,const unsigned char * __restrict__ src,unsigned int n,unsigned char key){
+	while(n--){
+		if(*src!=key)
+			*dst=*src;
+		++dst;
+		++src;
+	}
+}
+static inline void blitRowKeyedWords(unsigned char * __restrict__ dst,const unsigned char * __restrict__ src,unsigned int n,unsigned char key){
+	//Word stores need an aligned destination
+	while(n&&((size_t)dst&3)){
+		if(*src!=key)
+			*dst=*src;
+		++dst;
+		++src;
+		--n;
+	}
+	if(n>=4){
+		const uint32_t key4=(uint32_t)key*0x01010101;
+		unsigned int off=(size_t)src&3;
+		unsigned int words=n>>2;
+		blitWord * d=(blitWord *)dst;
+		const blitWord * s=(const blitWord *)(src-off);
+		uint32_t w,m;
+		if(off){
+			//Realign the source from the two words each group straddles
+			//The last word read always holds part of the group, so never
+			//reaches past the row
+			const unsigned int shl=off*8,shr=32-(off*8);
+			uint32_t lo,hi=*s++;
+			while(words--){
+				lo=hi;
+				hi=*s++;
+				#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+					w=(lo<<shl)|(hi>>shr);
+				#else
+					w=(lo>>shl)|(hi<<shr);
+				#endif
+				m=opaqueMask(w,key4);
+				if(m==0xFFFFFFFF)
+					*d=w;
+				else if(m)
+					*d=(*d&~m)|(w&m);
+				++d;
+			}
+		}else{
+			while(words--){
+				w=*s++;
+				m=opaqueMask(w,key4);
+				if(m==0xFFFFFFFF)
+					*d=w;
+				else if(m)
+					*d=(*d&~m)|(w&m);
+				++d;
+			}
+		}
+		dst+=n&~3;
+		src+=n&~3;
+		n&=3;
+	}
+	blitRowKeyedBytes(dst,src,n,key);
+}
+#if defined(BLIT_SSE2) || defined(BLIT_NEON)
+static inline void blitRowKeyedVector(unsigned char * __restrict__ dst,const unsigned char * __restrict__ src,unsigned int n,unsigned char key){
+#if defined(BLIT_SSE2)
+	const __m128i k=_mm_set1_epi8(key);
+	while(n>=16){
+		__m128i s=_mm_loadu_si128((const __m128i *)src);
+		__m128i m=_mm_cmpeq_epi8(s,k);
+		__m128i d=_mm_loadu_si128((const __m128i *)dst);
+		_mm_storeu_si128((__m128i *)dst,_mm_or_si128(_mm_and_si128(m,d),_mm_andnot_si128(m,s)));
+		dst+=16;
+		src+=16;
+		n-=16;
+	}
+#else
+	const uint8x16_t k=vdupq_n_u8(key);
+	while(n>=16){
+		uint8x16_t s=vld1q_u8(src);
+		vst1q_u8(dst,vbslq_u8(vceqq_u8(s,k),vld1q_u8(dst),s));
+		dst+=16;
+		src+=16;
+		n-=16;
+	}
+#endif
+	blitRowKeyedBytes(dst,src,n,key);
+}
+#endif
+static inline void blitRowKeyed(unsigned char * __restrict__ dst,const unsigned char * __restrict__ src,unsigned int n,unsigned char key){
+#if defined(BLIT_SSE2) || defined(BLIT_NEON)
+	blitRowKeyedVector(dst,src,n,key);
+#else
+	blitRowKeyedWords(dst,src,n,key);
+#endif
+}
+static inline void blitRowKeyedRemap(unsigned char * __restrict__ dst,const unsigned char * __restrict__ src,unsigned int n,unsigned char key,const unsigned char * remap){
+	//Each pixel still needs its own lookup, but transparent groups, which
+	//make up most of a font, are skipped a word at a time
+	while(n&&((size_t)src&3)){
+		if(*src!=key)
+			*dst=remap[*src];
+		++dst;
+		++src;
+		--n;
+	}
+	const uint32_t key4=(uint32_t)key*0x01010101;
+	while(n>=4){
+		if(opaqueMask(*(const blitWord *)src,key4)){
+			if(src[0]!=key)
+				dst[0]=remap[src[0]];
+			if(src[1]!=key)
+				dst[1]=remap[src[1]];
+			if(src[2]!=key)
+				dst[2]=remap[src[2]];
+			if(src[3]!=key)
+				dst[3]=remap[src[3]];
+		}
+		dst+=4;
+		src+=4;
+		n-=4;
+	}
+	while(n--){
+		if(*src!=key)
+			*dst=remap[*src];
+		++dst;
+		++src;
+	}
+}
 void setColKey(struct miniSurface * in,unsigned char entry){
 	in->flags|=miniS_COLKEY;
 	in->colkey=entry;
@@ -22,14 +214,9 @@ void MiniSurfToMiniSurf(const struct miniSurface * src,const struct miniSurface
 	unsigned char * dp=dst->pix+xo+(yo*dst->w);
 	while(maxY--){
 		if((src->flags&miniS_COLKEY)){
-			unsigned int x=maxX;
-			while(x--){
-				if(*sp!=src->colkey)
-					*dp=*sp;
-				++dp;
-				++sp;
-			}
-			dp+=dst->w-src->w;
+			blitRowKeyed(dp,sp,maxX,src->colkey);
+			sp+=maxX;
+			dp+=maxX+dst->w-src->w;
 		}else{
 			memcpy(dp,sp,maxX);
 			sp+=src->w;
@@ -43,15 +230,13 @@ void blitToCanvasRemap(const struct miniSurface * __restrict__ over,int xo,int y
 	unsigned char * dst=canvas.pix+xo+(yo*canvasW);
 	int maxX=over->w;
 	int maxY=over->h;
+	markDamage(xo,yo,maxX,maxY);
 	while(maxY--){
 		unsigned int x=maxX;
 		if((over->flags&miniS_COLKEY)){
-			while(x--){
-				if(*src!=over->colkey)
-					*dst=remap[*src];
-				++dst;
-				++src;
-			}
+			blitRowKeyedRemap(dst,src,maxX,over->colkey,remap);
+			dst+=maxX;
+			src+=maxX;
 		} else {
 			while(x--){
 				*dst++=remap[*src++];
@@ -103,18 +288,13 @@ void blitToCanvas(const struct miniSurface * __restrict__ over,int xo,int yo){
 	if(yo>canvasH){
 		return;
 	}
+	markDamage(xo,yo,maxX,maxY);
 	unsigned char * dst=canvas.pix+xo+(yo*canvasW);
 	while(maxY--){
 		if((over->flags&miniS_COLKEY)){
-			unsigned int x=maxX;
-			while(x--){
-				if(*src!=over->colkey)
-					*dst=*src;
-				++dst;
-				++src;
-			}
-			dst+=canvasW-maxX;
-			src+=over->w-maxX;
+			blitRowKeyed(dst,src,maxX,over->colkey);
+			dst+=canvasW;
+			src+=over->w;
 		}else{
 			memcpy(dst,src,maxX);
 			src+=over->w;
@@ -145,18 +325,13 @@ void blitPartToCanvas(const struct miniSurface * __restrict__ over,int xo,int yo
 		return;
 	if(maxY<1)
 		return;
+	markDamage(xo,yo,maxX,maxY);
 	unsigned char * dp=canvas.pix+xo+(yo*canvasW);
 	while(maxY--){
 		if((over->flags&miniS_COLKEY)){
-			unsigned int x=maxX;
-			while(x--){
-				if(*sp!=over->colkey)
-					*dp=*sp;
-				++dp;
-				++sp;
-			}
-			sp+=over->w-maxX;
-			dp+=canvasW-maxX;
+			blitRowKeyed(dp,sp,maxX,over->colkey);
+			sp+=over->w;
+			dp+=canvasW;
 		}else{
 			memcpy(dp,sp,maxX);
 			sp+=over->w;
@@ -165,3 +340,153 @@ void blitPartToCanvas(const struct miniSurface * __restrict__ over,int xo,int yo
 		
 	}
 }
+/* Spans list the opaque runs of a colour keyed surface, so drawing it needs
+no per-pixel tests. Each row is a run count followed by that many
+(skip, copy) byte pairs, where skip counts from the end of the previous run.
+Longer gaps and runs are split, with zero length pieces where needed. */
+int encodeSpans(const struct miniSurface * surf,unsigned char * out){
+	const unsigned char * sp=surf->pix;
+	int size=0;
+	int y;
+	for(y=0;y<surf->h;++y){
+		unsigned char * count=out?out+size:NULL;
+		int runs=0;
+		int x=0;
+		++size;
+		while(x<surf->w){
+			int skip=0,copy=0;
+			while((x<surf->w)&&(sp[x]==surf->colkey)){
+				++skip;
+				++x;
+			}
+			while((x<surf->w)&&(sp[x]!=surf->colkey)){
+				++copy;
+				++x;
+			}
+			if(!copy)
+				break;//Trailing transparent pixels need no run
+			while((skip>255)||(copy>255)){
+				int s=skip>255?255:skip;
+				int c=skip>255?0:255;
+				if(out){
+					out[size]=s;
+					out[size+1]=c;
+				}
+				size+=2;
+				skip-=s;
+				copy-=c;
+				++runs;
+			}
+			if(out){
+				out[size]=skip;
+				out[size+1]=copy;
+			}
+			size+=2;
+			++runs;
+		}
+		if(runs>255)
+			return -1;
+		if(count)
+			*count=runs;
+		sp+=surf->w;
+	}
+	return size;
+}
+void blitSpansToCanvas(const struct miniSurface * __restrict__ over,const unsigned char * spans,int xo,int yo){
+	const unsigned char * sp=over->pix;
+	int y;
+	if((xo>=canvasW)||(yo>=canvasH)||(xo+over->w<=0)||(yo+over->h<=0))
+		return;
+	markDamage(xo,yo,over->w,over->h);
+	for(y=0;y<over->h;++y){
+		int runs=*spans++;
+		int dy=yo+y;
+		if((dy<0)||(dy>=canvasH)){
+			spans+=runs*2;
+			sp+=over->w;
+			continue;
+		}
+		unsigned char * dp=canvas.pix+(dy*canvasW);
+		int x=0;
+		while(runs--){
+			x+=spans[0];
+			int l=xo+x;
+			int r=l+spans[1];
+			if(l<0)
+				l=0;
+			if(r>canvasW)
+				r=canvasW;
+			if(l<r)
+				memcpy(dp+l,sp+(l-xo),r-l);
+			x+=spans[1];
+			spans+=2;
+		}
+		sp+=over->w;
+	}
+}
+#ifdef BENCHMARK
+static unsigned int checkRand(unsigned int * seed){
+	*seed=(*seed*1103515245)+12345;
+	return *seed>>16;
+}
+/* Compare every way of copying a colour keyed row with testing each pixel,
+on random rows, keys and lengths, starting at every alignment of the source
+and destination. Rows are mostly transparent, mostly opaque or mixed, so
+both the skipped and the copied words are covered. Returns the number of
+copies which differed. */
+int checkRowBlits(int rows){
+	unsigned char src[ROWCHECK_LENGTH+8];
+	unsigned char remap[256];
+	unsigned char start[ROWCHECK_LENGTH+8];
+	unsigned char expected[ROWCHECK_LENGTH+8];
+	unsigned char result[ROWCHECK_LENGTH+8];
+	unsigned int seed=1;
+	int errors=0;
+	int row,count,n,srcOff,dstOff,opaque;
+	unsigned char key;
+	for(count=0;count<256;++count)
+		remap[count]=count^0x5A;
+	for(row=0;row<rows;++row){
+		key=checkRand(&seed);
+		n=checkRand(&seed)%(ROWCHECK_LENGTH+1);
+		srcOff=checkRand(&seed)&7;
+		dstOff=checkRand(&seed)&7;
+		//Out of 16, how many pixels are opaque
+		opaque=checkRand(&seed)%17;
+		for(count=0;count<ROWCHECK_LENGTH+8;++count){
+			src[count]=((int)(checkRand(&seed)&15)<opaque)?checkRand(&seed):key;
+			start[count]=checkRand(&seed);
+		}
+		//Plain copies
+		memcpy(expected,start,sizeof(expected));
+		blitRowKeyedBytes(expected+dstOff,src+srcOff,n,key);
+		memcpy(result,start,sizeof(result));
+		blitRowKeyedWords(result+dstOff,src+srcOff,n,key);
+		if(memcmp(result,expected,sizeof(result))){
+			printf("Word row copy differs: %d pixels, offsets %d and %d, key %d\n",n,srcOff,dstOff,key);
+			++errors;
+		}
+#if defined(BLIT_SSE2) || defined(BLIT_NEON)
+		memcpy(result,start,sizeof(result));
+		blitRowKeyedVector(result+dstOff,src+srcOff,n,key);
+		if(memcmp(result,expected,sizeof(result))){
+			printf("Vector row copy differs: %d pixels, offsets %d and %d, key %d\n",n,srcOff,dstOff,key);
+			++errors;
+		}
+#endif
+		//Remapped copies
+		memcpy(expected,start,sizeof(expected));
+		for(count=0;count<n;++count){
+			if(src[srcOff+count]!=key)
+				expected[dstOff+count]=remap[src[srcOff+count]];
+		}
+		memcpy(result,start,sizeof(result));
+		blitRowKeyedRemap(result+dstOff,src+srcOff,n,key,remap);
+		if(memcmp(result,expected,sizeof(result))){
+			printf("Remapped row copy differs: %d pixels, offsets %d and %d, key %d\n",n,srcOff,dstOff,key);
+			++errors;
+		}
+	}
+	return errors;
+}
+#endif
@@ -3,6 +3,10 @@
 	#include <SDL/SDL.h>
 #endif
 #define miniS_COLKEY 1
+// Dirty tile tracking. One bit per 32 * 32 cell, covering every tile that can
+// be partly visible on the canvas.
+#define DAMAGE_W 14
+#define DAMAGE_H 8
 struct miniSurface {
 	unsigned char * pix;
 	int w,h;
@@ -15,3 +19,14 @@ void MiniSurfToMiniSurf(const struct miniSurface * src,const struct miniSurface
 void blitToCanvas(const struct miniSurface * __restrict__ over,int xo,int yo);
 void blitToCanvasRemap(const struct miniSurface * __restrict__ over,int xo,int yo, const unsigned char * remap);
 void blitPartToCanvas(const struct miniSurface * __restrict__ over,int xo,int yo,const short * part);
+int encodeSpans(const struct miniSurface * surf,unsigned char * out);
+void blitSpansToCanvas(const struct miniSurface * __restrict__ over,const unsigned char * spans,int xo,int yo);
+void startDamage(int xOffset,int yOffset);
+void stopDamage(void);
+void markDamage(int x,int y,int w,int h);
+extern unsigned short canvasDamage[DAMAGE_H];
+#ifdef BENCHMARK
+// Longest row tried by checkRowBlits
+#define ROWCHECK_LENGTH 300
+int checkRowBlits(int rows);
+#endif